@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "image.h"
+#include "dragon.h"
+
+/* Iterations above RASTER_MAX_ITERATIONS are rendered by
+ * dragon_density_render() at DENSITY_WIDTH x DENSITY_HEIGHT: the raster image
+ * of iteration n takes 1.5 * 4^n bytes, 384 MiB for iteration 14.
+ */
+enum {RASTER_MAX_ITERATIONS = 14, DENSITY_WIDTH = 3840, DENSITY_HEIGHT = 2160};
+
+static const char *bench_output = "bench.pgm";
+
+/* Returns a monotonic time in seconds. */
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Returns the 64-bit FNV-1a hash of the size and pixel data of image. */
+static uint64_t image_hash(image_t *image)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	int header[2] = {image->width, image->height};
+	const uint8_t *bytes = (const uint8_t *) header;
+	for (size_t i = 0; i < sizeof(header); i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	for (int j = 0; j < image->height; j++)
+	{
+		const uint8_t *row = image_row(image, j);
+		for (int i = 0; i < image->widthStep; i++)
+		{
+			hash = (hash ^ row[i]) * 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+/* Looks up the golden hash of the given iteration in filename, a file of
+ * "iterations hash" lines. Returns 1 and sets hash if it is present.
+ */
+static int golden_hash(const char *filename, int iterations, uint64_t *hash)
+{
+	FILE *in = fopen(filename, "r");
+	if (in == NULL)
+	{
+		return 0;
+	}
+	int n;
+	uint64_t value;
+	int found = 0;
+	while (!found && fscanf(in, "%d %" SCNx64, &n, &value) == 2)
+	{
+		if (n == iterations)
+		{
+			*hash = value;
+			found = 1;
+		}
+	}
+	fclose(in);
+	return found;
+}
+
+/* Renders, writes and hashes one iteration and prints its results. Returns
+ * EXIT_FAILURE if the hash does not match its golden value or there is none.
+ */
+static int bench_iteration(int iterations, const char *golden)
+{
+	long size = 1L << iterations;
+	double steps = 2.0 * size * size;
+	int raster = iterations <= RASTER_MAX_ITERATIONS;
+
+	double start = now();
+	image_t *image = raster
+		? dragon_render(size, 2 * iterations)
+		: dragon_density_render(size, 2 * iterations, DENSITY_WIDTH,
+		                        DENSITY_HEIGHT);
+	double render = now() - start;
+
+	start = now();
+	image_error_t res = image_write(bench_output, image, PGM_FORMAT);
+	double write = now() - start;
+	unlink(bench_output);
+	if (res != IMG_OK)
+	{
+		image_print_error(res);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t hash = image_hash(image);
+	uint64_t expected;
+	int checked = golden_hash(golden, iterations, &expected);
+	int passed = checked && hash == expected;
+	const char *status = !checked ? "no golden" : passed ? "ok" : "MISMATCH";
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("%5d %-7s %12.4g %9.3f %10.4g %10.4g %8.3f %9.1f  %016" PRIx64
+	       "  %s\n", iterations, raster ? "raster" : "density", steps, render,
+	       steps / render, (double) image->width * image->height / render,
+	       write, usage.ru_maxrss / 1024.0, hash, status);
+	image_free(image);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Benchmarks the renderer for each iteration from the first to the last
+ * argument, checking output hashes against the golden file given as the third
+ * argument. Each iteration runs in its own process so that the reported peak
+ * RSS is its own.
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 4)
+	{
+		fprintf(stderr, "Usage: %s first_iteration last_iteration golden_file\n",
+		        argv[0]);
+		return EXIT_FAILURE;
+	}
+	int first = atoi(argv[1]);
+	int last = atoi(argv[2]);
+
+	printf("%5s %-7s %12s %9s %10s %10s %8s %9s  %-16s  %s\n", "iter", "mode",
+	       "steps", "render_s", "steps/s", "pixels/s", "write_s", "rss_MiB",
+	       "hash", "status");
+	fflush(stdout);
+
+	int failures = 0;
+	for (int n = first; n <= last; n++)
+	{
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+		if (pid == 0)
+		{
+			exit(bench_iteration(n, argv[3]));
+		}
+		int status;
+		if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+		    || WEXITSTATUS(status) != EXIT_SUCCESS)
+		{
+			failures++;
+		}
+	}
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -4,8 +4,10 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <limits.h>
 #include "image.h"
 #include "dragon.h"
+#include "path.h"
 
 /* x, y: coordinates of turtle */
 static long x, y;
@@ -40,6 +42,21 @@ vector_t starting_direction(int total_iterations)
   }
 }
 
+/* Returns the pixel intensity of the given grey band.
+ */
+static uint8_t grey_value(long level)
+{
+	switch (level)
+	{
+		case 0: return 100;
+		case 1: return 120;
+		case 2: return 150;
+		case 3: return 180;
+		case 4: return 200;
+		default: return 255;
+	}
+}
+
 /* Draws a pixel to dst at location (x, y). The pixel intensity is chosen as a
  * function of image size and the number of pixels drawn.
  *
@@ -50,17 +67,84 @@ vector_t starting_direction(int total_iterations)
 void draw_greyscale(image_t *dst, long x, long y)
 {
 	int level = LEVEL * drawn_pixels / (dst->height * dst->height);
-	uint8_t value;
-	switch (level)
+	set_pixel(dst, x, y, grey_value(level));
+}
+
+/* Draws every step of block to dst. Equivalent to calling draw_greyscale()
+ * for each step, but the grey band is only recomputed where it changes and
+ * pixels are written through image_row(): the path is known to stay inside
+ * the image.
+ */
+static void draw_block(image_t *dst, const path_block_t *block)
+{
+	long band = (long) dst->height * dst->height;
+	int channels = dst->nChannels;
+	uint8_t *row = NULL;
+	long row_y = -1;
+	/* Positions are never negative and scale is a power of two, so the
+	 * division by scale can be a shift. */
+	assert((scale & (scale - 1)) == 0);
+	int shift = 0;
+	while ((1L << shift) < scale)
+	{
+		shift++;
+	}
+	int i = 0;
+	while (i < block->length)
+	{
+		/* Step i is drawn pixel number first + i + 1. */
+		long level = LEVEL * (long) (block->first + i + 1) / band;
+		long end = block->length;
+		/* Bands from 5 onwards are all drawn white. */
+		if (level < 5)
+		{
+			long next_band = ((level + 1) * band + LEVEL - 1) / LEVEL;
+			if (next_band - (long) block->first - 1 < end)
+			{
+				end = next_band - (long) block->first - 1;
+			}
+		}
+		uint8_t value = grey_value(level);
+		for (; i < end; i++)
+		{
+			/* Consecutive steps often stay on one row. */
+			long y = block->y[i] >> shift;
+			if (y != row_y)
+			{
+				row = image_row(dst, y);
+				row_y = y;
+			}
+			row[(block->x[i] >> shift) * channels] = value;
+		}
+	}
+}
+
+/* Counts the 2^level steps of a run of the path, whose shape is shapes[shape]
+ * and whose first step starts at (x, y), onto the grid of d. A run whose
+ * steps all start in one cell is counted at once; others are split into the
+ * two runs of the level below. Counts saturate rather than wrap so very long
+ * paths stay monotone.
+ */
+static void density_run(density_t *d, const path_shape_t *shapes, int level,
+                        int parity, int dir, long x, long y)
+{
+	const path_shape_t *shape = &shapes[PATH_SHAPE(level, parity, dir)];
+	long ox = d->offset_x + (x + shape->min_x) * d->num / d->den;
+	long oy = d->offset_y + (y + shape->min_y) * d->num / d->den;
+	if (level == 0
+	    || (ox == d->offset_x + (x + shape->max_x) * d->num / d->den
+	        && oy == d->offset_y + (y + shape->max_y) * d->num / d->den))
 	{
-		case 0: value = 100; break;
-		case 1: value = 120; break;
-		case 2: value = 150; break;
-		case 3: value = 180; break;
-		case 4: value = 200; break;
-		default: value = 255;
+		uint32_t *hits = &d->hits[oy * d->width + ox];
+		uint64_t count = *hits + (1ULL << level);
+		*hits = count < UINT32_MAX ? (uint32_t) count : UINT32_MAX;
+		return;
 	}
-	set_pixel(dst, x, y, value);
+	const path_shape_t *first = &shapes[PATH_SHAPE(level - 1, 0, dir)];
+	density_run(d, shapes, level - 1, 0, dir, x, y);
+	density_run(d, shapes, level - 1, 1,
+	            (first->end_dir + (parity ? 2 : 6)) & 7, x + first->dx,
+	            y + first->dy);
 }
 
 /* 45 degrees rotation.
@@ -152,40 +236,211 @@ void string_iteration(image_t *dst, const char *str, int iterations)
 	}
 }
 
-/* Creates an image of requested size, calls starting_direction() to compute
- * initial turtle direction then calls string_iteration() to construct the
- * image. The constructed image is saved to a file in the output directory.
+/* Draws the twin dragon of total_iterations into dst starting from (x, y),
+ * producing the same image as string_iteration() but walking the path in
+ * blocks instead of expanding the L-system recursively.
  */
-void dragon(long size, int total_iterations)
+static void draw_path(image_t *dst, long x, long y, int total_iterations)
+{
+	path_t path;
+	path_block_t *block = malloc(sizeof(path_block_t));
+	if (block == NULL)
+	{
+		image_print_error(IMG_INSUFFICIENT_MEMORY);
+		exit(EXIT_FAILURE);
+	}
+	path_init(&path, x, y, total_iterations);
+	while (path_next_block(&path, block))
+	{
+		draw_block(dst, block);
+	}
+	free(block);
+}
+
+/* Creates an image of requested size then calls draw_path() to construct the
+ * image, which draws the same path as starting_direction() and
+ * string_iteration() would. The caller owns the returned image.
+ */
+image_t *dragon_render(long size, int total_iterations)
 {
-	image_t **dst = malloc(sizeof(image_t *));
-	image_error_t res = init_image(dst, size * 1.5, size, 1, 255);
+	image_t *dst;
+	image_error_t res = init_image(&dst, size * 1.5, size, 1, 255);
 	if (res != IMG_OK) {
 		image_print_error(res);
 		exit(EXIT_FAILURE);
 	}
-	x = size;
-	y = size;
 	scale = 2;
-	direction = starting_direction(total_iterations);
-	string_iteration(*dst, "FX+FX+", total_iterations);
-	image_write("twindragon.pgm", *dst, PGM_FORMAT);
+	draw_path(dst, size, size, total_iterations);
+	return dst;
+}
+
+/* Renders the dragon with dragon_render(). The constructed image is saved to a
+ * file in the output directory.
+ */
+void dragon(long size, int total_iterations)
+{
+	image_t *dst = dragon_render(size, total_iterations);
+	image_error_t res = image_write("twindragon.pgm", dst, PGM_FORMAT);
+	if (res != IMG_OK) {
+		image_print_error(res);
+		exit(EXIT_FAILURE);
+	}
+	image_free(dst);
+}
+
+/* Renders the animation frames dragon(2^n, 2n) for n = 1 .. iterations,
+ * writing frame n to twindragon_<n>.pgm.
+ *
+ * Each frame is rendered on its own with dragon_render(). Nothing is carried
+ * over from the previous frame: the image doubles in size, the path starts
+ * from a new point, the second half of the twin dragon begins at a different
+ * step, and the grey bands are relative to the path length, so neither
+ * pixels nor path state can be reused.
+ */
+void dragon_sequence(int iterations)
+{
+	char filename[32];
+	for (int n = 1; n <= iterations; n++)
+	{
+		image_t *dst = dragon_render(1L << n, 2 * n);
+		snprintf(filename, sizeof(filename), "twindragon_%02d.pgm", n);
+		image_error_t res = image_write(filename, dst, PGM_FORMAT);
+		if (res != IMG_OK) {
+			image_print_error(res);
+			exit(EXIT_FAILURE);
+		}
+		image_free(dst);
+	}
+}
+
+/* Counts the steps of the twin dragon of total_iterations landing in each cell
+ * of a fixed width x height grid rather than a size-dependent image, without
+ * walking the steps one at a time: see density_run(). The turtle path spans
+ * [0, 3 * size) x [0, 2 * size); it is scaled uniformly to fit the grid and
+ * centred. Memory use depends only on the grid size. Returns
+ * the largest count; the caller frees grid->hits.
+ */
+static uint32_t density_count(density_t *grid, long size, int total_iterations,
+                              int width, int height)
+{
+	grid->width = width;
+	grid->height = height;
+	grid->hits = calloc((size_t) width * height, sizeof(uint32_t));
+	if (grid->hits == NULL)
+	{
+		image_print_error(IMG_INSUFFICIENT_MEMORY);
+		exit(EXIT_FAILURE);
+	}
+	/* Fit the 3:2 path box into the grid without distorting it. */
+	if ((long) width * 2 <= (long) height * 3)
+	{
+		grid->num = width;
+		grid->den = 3 * size;
+	}
+	else
+	{
+		grid->num = height;
+		grid->den = 2 * size;
+	}
+	grid->offset_x = (width - 3 * size * grid->num / grid->den) / 2;
+	grid->offset_y = (height - 2 * size * grid->num / grid->den) / 2;
+
+	/* Each half of the twin dragon is one run of 2^total_iterations steps,
+	 * the second starting with an anticlockwise turn. */
+	path_shape_t *shapes = path_shapes(total_iterations);
+	if (shapes == NULL)
+	{
+		image_print_error(IMG_INSUFFICIENT_MEMORY);
+		exit(EXIT_FAILURE);
+	}
+	int dir = total_iterations % 8;
+	const path_shape_t *half = &shapes[PATH_SHAPE(total_iterations, 0, dir)];
+	density_run(grid, shapes, total_iterations, 0, dir, size, size);
+	density_run(grid, shapes, total_iterations, 0, (half->end_dir + 6) & 7,
+	            size + half->dx, size + half->dy);
+	free(shapes);
+
+	uint32_t max_hits = 0;
+	for (size_t i = 0; i < (size_t) width * height; i++)
+	{
+		if (grid->hits[i] > max_hits)
+		{
+			max_hits = grid->hits[i];
+		}
+	}
+	return max_hits;
+}
+
+/* Tone-maps row j of grid logarithmically to 8 bits, so that max_hits maps to
+ * white.
+ */
+static void density_tone_map(const density_t *grid, uint32_t max_hits, int j,
+                             uint8_t *row)
+{
+	double norm = max_hits > 0 ? 255.0 / log1p(max_hits) : 0.0;
+	const uint32_t *hits = &grid->hits[(size_t) j * grid->width];
+	for (int i = 0; i < grid->width; i++)
+	{
+		row[i] = (uint8_t) lround(log1p(hits[i]) * norm);
+	}
+}
+
+/* Renders the twin dragon of total_iterations onto a fixed width x height
+ * grid with density_count(), tone-mapping the counts when the path is
+ * complete. The caller owns the returned image.
+ */
+image_t *dragon_density_render(long size, int total_iterations, int width,
+                               int height)
+{
+	density_t grid;
+	uint32_t max_hits = density_count(&grid, size, total_iterations, width,
+	                                  height);
+	image_t *dst;
+	image_error_t res = init_image(&dst, width, height, 1, 255);
 	if (res != IMG_OK) {
 		image_print_error(res);
 		exit(EXIT_FAILURE);
 	}
-	image_free(*dst);
-	free(dst);
+	for (int j = 0; j < height; j++)
+	{
+		density_tone_map(&grid, max_hits, j, image_row(dst, j));
+	}
+	free(grid.hits);
+	return dst;
 }
 
-/* The main function. When called with an argument, this should be considered
- * the number of iterations to execute. Otherwise, it is assumed to be 9. Image
- * size is computed from the number of iterations then dragon() is used to
- * generate the dragon image. */
-int main(int argc, char **argv)
+/* Renders the dragon like dragon_density_render(), but tone-maps the counts a
+ * band of rows at a time straight into twindragon.pgm in the output directory,
+ * so no 8-bit copy of the whole image is ever held in memory.
+ */
+void dragon_density(long size, int total_iterations, int width, int height)
 {
-	assert(argc >= 1);
-	int iterations = atoi(argv[1]);
-	dragon(pow(2, iterations), 2 * iterations);
-	return EXIT_SUCCESS;
+	density_t grid;
+	uint32_t max_hits = density_count(&grid, size, total_iterations, width,
+	                                  height);
+	image_stream_t *stream;
+	int band_rows = STREAM_BUFFER_SIZE / width + 1;
+	image_error_t res = image_stream_create("twindragon.pgm", width, height, 1,
+	                                        band_rows, &stream);
+	if (res != IMG_OK) {
+		image_print_error(res);
+		exit(EXIT_FAILURE);
+	}
+	for (int j = 0; res == IMG_OK && j < height; j += band_rows)
+	{
+		int rows = height - j < band_rows ? height - j : band_rows;
+		for (int r = 0; r < rows; r++)
+		{
+			density_tone_map(&grid, max_hits, j + r,
+			                 stream->buffer + (size_t) r * width);
+		}
+		res = image_stream_write(stream, stream->buffer, rows);
+	}
+	image_error_t closed = image_stream_close(stream);
+	res = res == IMG_OK ? closed : res;
+	if (res != IMG_OK) {
+		image_print_error(res);
+		exit(EXIT_FAILURE);
+	}
+	free(grid.hits);
 }
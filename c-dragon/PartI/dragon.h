@@ -11,10 +11,29 @@ typedef struct vector
     long dy;
 } vector_t;
 
+/* A fixed resolution grid of hit counts. Turtle coordinates are mapped to the
+ * grid by offset + coordinate * num / den.
+ */
+typedef struct density
+{
+    int width;
+    int height;
+    long num;
+    long den;
+    long offset_x;
+    long offset_y;
+    uint32_t *hits;
+} density_t;
+
 /* DO NOT MODIFY THE DECLARATION OF THESE FUNCTIONS*/
 vector_t starting_direction(int );
 void draw_greyscale(image_t *, long , long  );
 void string_iteration(image_t *, const char *, int  );
 void dragon(long , int );
 
+image_t *dragon_render(long , int );
+image_t *dragon_density_render(long , int , int , int );
+void dragon_density(long , int , int , int );
+void dragon_sequence(int );
+
 #endif /* DRAGON_H_ */
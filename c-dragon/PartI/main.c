@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "image.h"
+#include "dragon.h"
+#include "vector.h"
+
+/* The main function. When called with an argument, this should be considered
+ * the number of iterations to execute. Otherwise, it is assumed to be 9. Image
+ * size is computed from the number of iterations then dragon() is used to
+ * generate the dragon image.
+ *
+ * With -d WIDTHxHEIGHT the dragon is rendered by dragon_density() at that
+ * fixed resolution instead, e.g. -d 3840x2160 for 4K output. With -s every
+ * frame from 1 up to the given number of iterations is rendered by
+ * dragon_sequence(). With -v FILE or -l FILE the path is exported by
+ * vector_write() as SVG or as a binary polyline respectively. With -p LEVELS
+ * an image pyramid of that many levels is written next to the raster image.
+ */
+int main(int argc, char **argv)
+{
+	int density_width = 0;
+	int density_height = 0;
+	bool sequence = false;
+	const char *vector_file = NULL;
+	vectorformat vector_format = SVG_FORMAT;
+	int pyramid_levels = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "d:sv:l:p:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd':
+				if (sscanf(optarg, "%dx%d", &density_width, &density_height) != 2
+				    || density_width <= 0 || density_height <= 0)
+				{
+					fprintf(stderr, "Invalid output size: %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's':
+				sequence = true;
+				break;
+			case 'v':
+				vector_file = optarg;
+				vector_format = SVG_FORMAT;
+				break;
+			case 'l':
+				vector_file = optarg;
+				vector_format = POLYLINE_FORMAT;
+				break;
+			case 'p':
+				pyramid_levels = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-d WIDTHxHEIGHT | -s | -v FILE | -l FILE]"
+				        " [-p LEVELS] [iterations]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	int iterations = optind < argc ? atoi(argv[optind]) : 9;
+	if (vector_file != NULL)
+	{
+		image_error_t res = vector_write(vector_file, pow(2, iterations),
+		                                 2 * iterations, vector_format);
+		if (res != IMG_OK)
+		{
+			image_print_error(res);
+			return EXIT_FAILURE;
+		}
+	}
+	else if (sequence)
+	{
+		dragon_sequence(iterations);
+	}
+	else if (density_width > 0)
+	{
+		dragon_density(pow(2, iterations), 2 * iterations, density_width,
+		               density_height);
+	}
+	else if (pyramid_levels > 0)
+	{
+		image_t *dst = dragon_render(pow(2, iterations), 2 * iterations);
+		image_error_t res = image_write("twindragon.pgm", dst, PGM_FORMAT);
+		if (res == IMG_OK)
+		{
+			res = image_write_pyramid("twindragon", dst, pyramid_levels,
+			                          sysconf(_SC_NPROCESSORS_ONLN));
+		}
+		if (res != IMG_OK)
+		{
+			image_print_error(res);
+			return EXIT_FAILURE;
+		}
+		image_free(dst);
+	}
+	else
+	{
+		dragon(pow(2, iterations), 2 * iterations);
+	}
+	return EXIT_SUCCESS;
+}
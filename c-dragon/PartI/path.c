@@ -0,0 +1,161 @@
+#include "path.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Builds the packed unit move (dx + 1) | (dy + 1) << 32 used by
+ * path_next_block().
+ */
+#define MOVE(dx, dy) ((uint64_t) ((dx) + 1) | (uint64_t) ((dy) + 1) << 32)
+
+/*
+ * Packed unit moves for each direction index, in the order used by
+ * starting_direction(): index + 1 is a 45 degree clockwise rotation.
+ */
+static const uint64_t dir_move[8] =
+  { MOVE(1, 0), MOVE(1, 1), MOVE(0, 1), MOVE(-1, 1),
+    MOVE(-1, 0), MOVE(-1, -1), MOVE(0, -1), MOVE(1, -1) };
+
+/*
+ * Returns true if the turtle turns clockwise ('-') before step k > 0 of the
+ * twin dragon of total_iterations, false if it turns anticlockwise ('+').
+ * Every step after the first is preceded by exactly one turn.
+ *
+ * Each half of the twin dragon is 2^total_iterations steps long and its turns
+ * follow the regular paperfolding sequence: writing k = m * 2^j with m odd,
+ * the turn is clockwise iff m % 4 == 3. This sequence is a prefix of the one
+ * for total_iterations + 1, so consecutive iterations share it.
+ */
+bool path_turns_clockwise(unsigned long k, int total_iterations)
+{
+  unsigned long j = k & ((1UL << total_iterations) - 1);
+  return j != 0 && (j & ((j & -j) << 1)) != 0;
+}
+
+/*
+ * Positions the turtle at (x, y) at the start of the twin dragon of
+ * total_iterations.
+ */
+void path_init(path_t *path, long x, long y, int total_iterations)
+{
+  path->total_iterations = total_iterations;
+  path->steps = 2UL << total_iterations;
+  path->next = 0;
+  path->dir = total_iterations % 8;
+  path->x = x;
+  path->y = y;
+}
+
+/*
+ * Fills block with the next PATH_BLOCK steps of the path, or fewer at its end.
+ * Returns false, leaving block empty, once the path is exhausted.
+ *
+ * The block is produced in three passes with no dependency on the image:
+ * turns are evaluated independently per step, summed into direction indices,
+ * and the unit moves are summed into positions. Both coordinates share one
+ * 64-bit accumulator, (dx + 1) in the low half and (dy + 1) in the high half,
+ * so the position scan is a single add per step; the biases keep each half
+ * non-negative and are removed afterwards.
+ */
+bool path_next_block(path_t *path, path_block_t *block)
+{
+  unsigned long remaining = path->steps - path->next;
+  int n = remaining < PATH_BLOCK ? (int) remaining : PATH_BLOCK;
+  block->first = path->next;
+  block->length = n;
+  if (n == 0)
+  {
+    return false;
+  }
+
+  /* Locals keep the byte stores to dir from forcing reloads of path. */
+  uint8_t *dir = block->dir;
+  unsigned long first = path->next;
+  int total_iterations = path->total_iterations;
+  for (int i = 0; i < n; i++)
+  {
+    unsigned long k = first + i;
+    dir[i] = k == 0 ? 0 : path_turns_clockwise(k, total_iterations) ? 2 : 6;
+  }
+
+  uint8_t d = path->dir;
+  for (int i = 0; i < n; i++)
+  {
+    d = (d + dir[i]) & 7;
+    dir[i] = d;
+  }
+
+  long x = path->x;
+  long y = path->y;
+  long *xs = block->x;
+  long *ys = block->y;
+  uint64_t packed = 0;
+  for (int i = 0; i < n; i++)
+  {
+    xs[i] = x + (long) (uint32_t) packed - i;
+    ys[i] = y + (long) (uint32_t) (packed >> 32) - i;
+    packed += dir_move[dir[i]];
+  }
+
+  path->x = x + (long) (uint32_t) packed - n;
+  path->y = y + (long) (uint32_t) (packed >> 32) - n;
+  path->dir = d;
+  path->next += n;
+  return true;
+}
+
+/*
+ * Returns a table, indexed with PATH_SHAPE(), of the shapes of every level
+ * from 0 to levels, or NULL if it cannot be allocated. The caller frees it.
+ *
+ * A run of level l > 0 is the run of level l - 1 at index 2a, with parity 0,
+ * then a turn before its middle step a * 2^l + 2^(l-1), whose odd part is
+ * 2a + 1, so the turn is clockwise iff a is odd, then the run of level l - 1
+ * at index 2a + 1, with parity 1.
+ */
+path_shape_t *path_shapes(int levels)
+{
+  path_shape_t *shapes = malloc((size_t) (levels + 1) * 16
+                                * sizeof(path_shape_t));
+  if (shapes == NULL)
+  {
+    return NULL;
+  }
+  for (int dir = 0; dir < 8; dir++)
+  {
+    for (int parity = 0; parity < 2; parity++)
+    {
+      path_shape_t *shape = &shapes[PATH_SHAPE(0, parity, dir)];
+      shape->dx = (long) (uint32_t) dir_move[dir] - 1;
+      shape->dy = (long) (uint32_t) (dir_move[dir] >> 32) - 1;
+      shape->min_x = shape->max_x = shape->min_y = shape->max_y = 0;
+      shape->end_dir = dir;
+    }
+  }
+  for (int level = 1; level <= levels; level++)
+  {
+    for (int parity = 0; parity < 2; parity++)
+    {
+      for (int dir = 0; dir < 8; dir++)
+      {
+        const path_shape_t *a = &shapes[PATH_SHAPE(level - 1, 0, dir)];
+        int turned = (a->end_dir + (parity ? 2 : 6)) & 7;
+        const path_shape_t *b = &shapes[PATH_SHAPE(level - 1, 1, turned)];
+        path_shape_t *shape = &shapes[PATH_SHAPE(level, parity, dir)];
+        shape->dx = a->dx + b->dx;
+        shape->dy = a->dy + b->dy;
+        shape->min_x = a->min_x < a->dx + b->min_x ? a->min_x
+                                                   : a->dx + b->min_x;
+        shape->max_x = a->max_x > a->dx + b->max_x ? a->max_x
+                                                   : a->dx + b->max_x;
+        shape->min_y = a->min_y < a->dy + b->min_y ? a->min_y
+                                                   : a->dy + b->min_y;
+        shape->max_y = a->max_y > a->dy + b->max_y ? a->max_y
+                                                   : a->dy + b->max_y;
+        shape->end_dir = b->end_dir;
+      }
+    }
+  }
+  return shapes;
+}
@@ -0,0 +1,69 @@
+#ifndef PATH_H_
+#define PATH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The number of steps produced by each call to path_next_block().
+ */
+enum {PATH_BLOCK = 4096};
+
+/*
+ * A turtle walking the twin dragon path traced by
+ * string_iteration(dst, "FX+FX+", total_iterations), one block at a time.
+ */
+typedef struct path
+{
+  int total_iterations;
+  unsigned long steps;
+  unsigned long next;
+  uint8_t dir;
+  long x, y;
+} path_t;
+
+/*
+ * A block of consecutive steps of a path. Step i of the block is step
+ * first + i of the path; it starts at (x[i], y[i]) and moves one unit in
+ * direction dir[i], using the direction indices of starting_direction().
+ */
+typedef struct path_block
+{
+  unsigned long first;
+  int length;
+  uint8_t dir[PATH_BLOCK];
+  long x[PATH_BLOCK];
+  long y[PATH_BLOCK];
+} path_block_t;
+
+/*
+ * The shape of a run of 2^level steps of a twin dragon half that starts at
+ * step a * 2^level, where parity is a % 2 and dir is the direction of its
+ * first step: its turns depend on nothing else. dx, dy is the move from its
+ * first step's start to the end of its last step, the min/max fields bound
+ * the starts of its steps relative to the first, and end_dir is the direction
+ * of its last step.
+ */
+typedef struct path_shape
+{
+  long dx, dy;
+  long min_x, max_x, min_y, max_y;
+  uint8_t end_dir;
+} path_shape_t;
+
+/*
+ * Index in a table from path_shapes() of the shape of the given level,
+ * parity and first direction.
+ */
+#define PATH_SHAPE(level, parity, dir) (((level) * 2 + (parity)) * 8 + (dir))
+
+/*
+ * API prototypes.
+ */
+
+void path_init(path_t *path, long x, long y, int total_iterations);
+bool path_next_block(path_t *path, path_block_t *block);
+bool path_turns_clockwise(unsigned long step, int total_iterations);
+path_shape_t *path_shapes(int levels);
+
+#endif /* PATH_H_ */
@@ -0,0 +1,289 @@
+#include "vector.h"
+#include "image.h"
+#include "path.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Unit moves for each direction index, in the order used by
+ * starting_direction(), and the direction index of each unit move (dx, dy)
+ * at dir_index[dy + 1][dx + 1].
+ */
+static const int dir_dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const int dir_dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+static const int dir_index[3][3] = {{5, 6, 7}, {4, -1, 0}, {3, 2, 1}};
+
+/*
+ * An output file written through a fixed-size buffer. Once a write fails
+ * the writer stops writing and remembers the failure.
+ */
+typedef struct vector_writer
+{
+  FILE *out;
+  size_t used;
+  int failed;
+  vectorformat format;
+  char buffer[VECTOR_BUFFER_SIZE];
+} vector_writer_t;
+
+/*
+ * Writes out everything buffered so far.
+ */
+static void writer_flush(vector_writer_t *writer)
+{
+  if (!writer->failed && writer->used > 0
+      && fwrite(writer->buffer, writer->used, 1, writer->out) != 1)
+  {
+    writer->failed = 1;
+  }
+  writer->used = 0;
+}
+
+/*
+ * Makes room for at least n more bytes in the buffer.
+ */
+static char *writer_reserve(vector_writer_t *writer, size_t n)
+{
+  if (writer->used + n > VECTOR_BUFFER_SIZE)
+  {
+    writer_flush(writer);
+  }
+  return writer->buffer + writer->used;
+}
+
+static void writer_puts(vector_writer_t *writer, const char *str)
+{
+  size_t n = strlen(str);
+  memcpy(writer_reserve(writer, n), str, n);
+  writer->used += n;
+}
+
+/*
+ * Appends the decimal form of value, preceded by the character prefix.
+ */
+static void writer_put_long(vector_writer_t *writer, char prefix, long value)
+{
+  char *out = writer_reserve(writer, 24);
+  char digits[20];
+  int n = 0;
+  unsigned long magnitude = value < 0 ? -(unsigned long) value
+                                        : (unsigned long) value;
+  do
+  {
+    digits[n++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+
+  *out++ = prefix;
+  if (value < 0)
+  {
+    *out++ = '-';
+  }
+  while (n > 0)
+  {
+    *out++ = digits[--n];
+  }
+  writer->used = out - writer->buffer;
+}
+
+/*
+ * Appends value as a LEB128 varint.
+ */
+static void writer_put_varint(vector_writer_t *writer, uint64_t value)
+{
+  uint8_t *out = (uint8_t *) writer_reserve(writer, 10);
+  while (value >= 0x80)
+  {
+    *out++ = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (uint8_t) value;
+  writer->used = (char *) out - writer->buffer;
+}
+
+/*
+ * Appends value as a little-endian int64.
+ */
+static void writer_put_int64(vector_writer_t *writer, long value)
+{
+  uint8_t *out = (uint8_t *) writer_reserve(writer, 8);
+  for (int i = 0; i < 8; i++)
+  {
+    out[i] = (uint8_t) ((uint64_t) value >> (8 * i));
+  }
+  writer->used += 8;
+}
+
+/*
+ * Appends the segment of length steps in direction dir.
+ */
+static void writer_put_segment(vector_writer_t *writer, int dir, long length)
+{
+  long dx = dir_dx[dir] * length;
+  long dy = dir_dy[dir] * length;
+  if (writer->format == POLYLINE_FORMAT)
+  {
+    writer_put_varint(writer, (uint64_t) length << 3 | dir);
+  }
+  else if (dy == 0)
+  {
+    writer_put_long(writer, 'h', dx);
+  }
+  else if (dx == 0)
+  {
+    writer_put_long(writer, 'v', dy);
+  }
+  else
+  {
+    writer_put_long(writer, 'l', dx);
+    writer_put_long(writer, ' ', dy);
+  }
+}
+
+/*
+ * The segment being built: length unit moves in direction dir.
+ */
+typedef struct vector_segment
+{
+  int dir;
+  long length;
+} vector_segment_t;
+
+/*
+ * Extends the path by length unit moves in direction dir. A move in the
+ * direction of the segment lengthens it; any other move writes the segment
+ * out and starts a new one.
+ */
+static void segment_extend(vector_writer_t *writer, vector_segment_t *segment,
+                           int dir, long length)
+{
+  if (dir != segment->dir)
+  {
+    if (segment->length > 0)
+    {
+      writer_put_segment(writer, segment->dir, segment->length);
+    }
+    segment->dir = dir;
+    segment->length = 0;
+  }
+  segment->length += length;
+}
+
+/*
+ * Extends the path by the chord of a step in direction a followed by one in
+ * direction b, a quarter turn apart: a diagonal unit move if both are along
+ * an axis, or two unit moves along an axis if both are diagonal.
+ */
+static void segment_extend_pair(vector_writer_t *writer,
+                                vector_segment_t *segment, int a, int b)
+{
+  int dx = dir_dx[a] + dir_dx[b];
+  int dy = dir_dy[a] + dir_dy[b];
+  int length = dx != 0 && dy != 0 ? 1 : 2;
+  segment_extend(writer, segment, dir_index[dy / length + 1][dx / length + 1],
+                 length);
+}
+
+/*
+ * Writes the twin dragon of total_iterations, as drawn by dragon(), to the
+ * given file as a vector path in turtle units, two to a pixel of the raster
+ * image.
+ *
+ * The turtle turns a quarter turn before every step, so no two steps are
+ * collinear. Each odd step and the even step after it are drawn instead as
+ * one chord from the start of the first to the end of the second, cutting the
+ * corner between them; every odd vertex of the path stays exact. The turns
+ * before odd steps alternate, so two consecutive chords are collinear
+ * whenever the turns between them cancel, and runs of collinear chords merge
+ * into one segment. This gives 3/8 of a segment per step. The output is
+ * streamed through a VECTOR_BUFFER_SIZE buffer so memory use does not grow
+ * with the path. Returns IMG_OK on success, or an appropriate error code on
+ * failure.
+ */
+image_error_t vector_write(const char *filename, long size,
+                           int total_iterations, vectorformat format)
+{
+  vector_writer_t *writer = malloc(sizeof(vector_writer_t));
+  path_block_t *block = malloc(sizeof(path_block_t));
+  if (writer == NULL || block == NULL)
+  {
+    free(writer);
+    free(block);
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+  writer->out = fopen(filename, "wb");
+  if (writer->out == NULL)
+  {
+    free(writer);
+    free(block);
+    return IMG_OPEN_FAILURE;
+  }
+  writer->used = 0;
+  writer->failed = 0;
+  writer->format = format;
+
+  if (format == POLYLINE_FORMAT)
+  {
+    writer_puts(writer, "DPL1");
+    writer_put_int64(writer, size);
+    writer_put_int64(writer, size);
+  }
+  else
+  {
+    writer_puts(writer, "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+                "viewBox=\"0 0");
+    writer_put_long(writer, ' ', 3 * size);
+    writer_put_long(writer, ' ', 2 * size);
+    writer_puts(writer, "\">\n<path fill=\"none\" stroke=\"black\" "
+                "stroke-width=\"1\" d=\"M");
+    writer_put_long(writer, ' ', size);
+    writer_put_long(writer, ' ', size);
+  }
+
+  /* The first and last steps have no partner and are drawn on their own. */
+  path_t path;
+  path_init(&path, size, size, total_iterations);
+  vector_segment_t segment = {-1, 0};
+  int odd_dir = -1;
+  while (path_next_block(&path, block))
+  {
+    for (int i = 0; i < block->length; i++)
+    {
+      if ((block->first + i) % 2 == 1)
+      {
+        odd_dir = block->dir[i];
+      }
+      else if (odd_dir < 0)
+      {
+        segment_extend(writer, &segment, block->dir[i], 1);
+      }
+      else
+      {
+        segment_extend_pair(writer, &segment, odd_dir, block->dir[i]);
+      }
+    }
+  }
+  segment_extend(writer, &segment, odd_dir, 1);
+  writer_put_segment(writer, segment.dir, segment.length);
+  free(block);
+
+  if (format == POLYLINE_FORMAT)
+  {
+    writer_put_varint(writer, 0);
+  }
+  else
+  {
+    writer_puts(writer, "\"/>\n</svg>\n");
+  }
+  writer_flush(writer);
+
+  int failed = writer->failed;
+  if (fclose(writer->out) != 0)
+  {
+    failed = 1;
+  }
+  free(writer);
+  return failed ? IMG_WRITE_FAILURE : IMG_OK;
+}
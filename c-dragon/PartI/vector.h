@@ -0,0 +1,33 @@
+#ifndef VECTOR_H_
+#define VECTOR_H_
+
+#include "image.h"
+
+/*
+ * The vector formats the exporter can write:
+ *
+ * SVG_FORMAT: a single SVG path.
+ * POLYLINE_FORMAT: a binary polyline. The file starts with the magic "DPL1"
+ * and the start point as two little-endian int64 values. Each segment then
+ * follows as the LEB128 varint (length << 3 | direction), using the direction
+ * indices of starting_direction(), and a zero varint ends the path. A segment
+ * of fewer than 16 units takes a single byte.
+ *
+ * Both formats give the path in the turtle units of dragon(), two to a pixel
+ * of its raster image, through every odd vertex of the turtle's path.
+ */
+typedef enum {SVG_FORMAT, POLYLINE_FORMAT} vectorformat;
+
+/*
+ * The size of the buffer the exporter streams its output through.
+ */
+enum {VECTOR_BUFFER_SIZE = 1 << 16};
+
+/*
+ * API prototypes.
+ */
+
+image_error_t vector_write(const char *filename, long size,
+                           int total_iterations, vectorformat format);
+
+#endif /* VECTOR_H_ */
@@ -0,0 +1,134 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "image.h"
+
+/* Each benchmark image is written to bench_file, read ROUNDS times with
+ * image_read() and once with a naive fscanf() loop, and then deleted.
+ */
+enum {ROUNDS = 3};
+static const char *bench_file = "ascii_bench.pnm";
+
+/* Returns a monotonic time in seconds. */
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Writes a plain PGM (P2) or PPM (P3) image of random samples to bench_file,
+ * with max_value as its depth and 12 samples per line, and returns its size
+ * in bytes.
+ */
+static long write_plain(char kind, int width, int height, int max_value)
+{
+  FILE *out = fopen(bench_file, "w");
+  if (out == NULL)
+  {
+    perror(bench_file);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(out, "P%c\n# benchmark image\n%d %d\n%d\n", kind, width, height,
+          max_value);
+  long samples = (long) width * height * (kind == '3' ? 3 : 1);
+  srand(1);
+  for (long i = 0; i < samples; i++)
+  {
+    fprintf(out, "%d%c", rand() % (max_value + 1), i % 12 == 11 ? '\n' : ' ');
+  }
+  long size = ftell(out);
+  fclose(out);
+  return size;
+}
+
+/* Reads bench_file the obvious way, one fscanf() per sample, rescaling like
+ * image_read(). Returns NULL on failure.
+ */
+static image_t *read_fscanf(void)
+{
+  FILE *in = fopen(bench_file, "r");
+  char kind;
+  int width, height, max_value;
+  if (in == NULL
+      || fscanf(in, "P%c # benchmark image %d %d %d", &kind, &width, &height,
+                &max_value) != 4)
+  {
+    return NULL;
+  }
+  image_t *image;
+  if (init_image(&image, width, height, kind == '3' ? RGB : GRAY, DEPTH)
+      != IMG_OK)
+  {
+    return NULL;
+  }
+  long samples = (long) image->widthStep * height;
+  for (long i = 0; i < samples; i++)
+  {
+    int value;
+    if (fscanf(in, "%d", &value) != 1)
+    {
+      image_free(image);
+      return NULL;
+    }
+    image->pixelsData[i] = (value * DEPTH + max_value / 2) / max_value;
+  }
+  fclose(in);
+  return image;
+}
+
+/* Benchmarks one image and prints a line of results. Returns 1 if both
+ * readers agree.
+ */
+static int bench(char kind, int width, int height, int max_value)
+{
+  double mb = write_plain(kind, width, height, max_value) / 1e6;
+
+  image_t *fast = NULL;
+  double fast_s = 0.0;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    image_free(fast);
+    double start = now();
+    image_error_t res = image_read(bench_file, &fast);
+    double elapsed = now() - start;
+    if (res != IMG_OK)
+    {
+      image_print_error(res);
+      exit(EXIT_FAILURE);
+    }
+    if (r == 0 || elapsed < fast_s)
+    {
+      fast_s = elapsed;
+    }
+  }
+
+  double start = now();
+  image_t *naive = read_fscanf();
+  double naive_s = now() - start;
+  remove(bench_file);
+
+  int ok = naive != NULL
+           && memcmp(fast->pixelsData, naive->pixelsData,
+                     (size_t) fast->widthStep * fast->height) == 0;
+  printf("P%c %5dx%-5d %5d %8.1f %11.1f %11.1f %7.1fx  %s\n", kind, width,
+         height, max_value, mb, mb / fast_s, mb / naive_s, naive_s / fast_s,
+         ok ? "ok" : "MISMATCH");
+  image_free(fast);
+  image_free(naive);
+  return ok;
+}
+
+/* Compares image_read() on plain PGM/PPM files against fscanf(). */
+int main(void)
+{
+  printf("%-14s %5s %8s %11s %11s %8s  %s\n", "image", "max", "MB",
+         "read_MB/s", "fscanf_MB/s", "speedup", "check");
+  int ok = bench('2', 2000, 2000, 255);
+  ok &= bench('3', 1500, 1000, 255);
+  ok &= bench('2', 2000, 1000, 65535);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,1806 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "image.h"
+#include "kernels.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//////////////////////////////////////////////////////////////
+//DO NOT MODIFY ANYTHING FROM THIS FILE///////////////////////
+//////////////////////////////////////////////////////////////
+
+/*
+ * A table of error messages relating to the error codes defined in
+ * image_error_t.
+ */
+static const char *image_error_table[] =
+  { "",
+    "Error: could not open supplied file.",
+    "Error: could not read image format from supplied file.",
+    "Error: invalid image format found in supplied file.",
+    "Error: insufficient memory to process supplied file.",
+    "Error: supplied file does not contain valid image sizes.",
+    "Error: supplied file contains an invalid depth.",
+    "Error: could not read pixel data from supplied file.",
+    "Error: could not write pixel data from supplied file."
+  };
+
+/*
+ * Prints an error message that corresponds to the supplied error code.
+ */
+void image_print_error(image_error_t error)
+{
+  fprintf(stderr,"%s\n", image_error_table[error]);
+}
+
+/*
+ * Frees the memory associated with a PPM/PBM image. It is safe to pass NULL to
+ * this function.
+ */
+void image_free(image_t *image)
+{
+  if (image == NULL)
+  {
+    return;
+  }
+
+  if (image->mapping != NULL)
+  {
+    munmap(image->mapping, image->mappingSize);
+  }
+  else if (image->pixelsData != NULL)
+  {
+    free(image->pixelsData);
+  }
+
+  free(image);
+}
+
+/*
+ * Parses an unsigned decimal field of a netpbm header, skipping whitespace
+ * and comments before it. Returns the position after the field, or NULL if
+ * there is no field before end.
+ */
+static const char *parse_header_field(const char *pos, const char *end,
+                                      int *value)
+{
+  while (pos < end && (*pos == '#' || *pos == ' ' || *pos == '\t'
+                       || *pos == '\n' || *pos == '\r'))
+  {
+    if (*pos == '#')
+    {
+      while (pos < end && *pos != '\n')
+      {
+        pos++;
+      }
+    }
+    else
+    {
+      pos++;
+    }
+  }
+  if (pos == end || *pos < '0' || *pos > '9')
+  {
+    return NULL;
+  }
+  long result = 0;
+  while (pos < end && *pos >= '0' && *pos <= '9' && result <= INT_MAX)
+  {
+    result = result * 10 + (*pos++ - '0');
+  }
+  if (pos == end || result > INT_MAX)
+  {
+    return NULL;
+  }
+  *value = result;
+  return pos;
+}
+
+/*
+ * Run-length encoded images (RLE_FORMAT) have a netpbm-style header, "R5" for
+ * gray or "R6" for RGB followed by the width, height and depth, then a single
+ * whitespace character and the rows in order. Each row's bytes are PackBits
+ * packets: a control byte n of 0 to 127 is followed by n + 1 literal bytes,
+ * and one of 129 to 255 by a single byte repeated 257 - n times. Packets never
+ * span rows. A row that consists of the single control byte RLE_REPEAT_ROW,
+ * a no-op in PackBits, is a copy of the row above it.
+ */
+enum {RLE_REPEAT_ROW = 128, RLE_MAX_PACKET = 128};
+
+/*
+ * Decodes the size bytes of RLE rows at src into image, whose size has been
+ * set. Returns IMG_OK, or IMG_READ_FAILURE if the data is truncated or
+ * malformed.
+ */
+static image_error_t rle_decode(image_t *image, const uint8_t *src,
+                                size_t size)
+{
+  const uint8_t *end = src + size;
+  for (int y = 0; y < image->height; y++)
+  {
+    uint8_t *row = image_row(image, y);
+    uint8_t *row_end = row + image->widthStep;
+    if (y > 0 && src < end && *src == RLE_REPEAT_ROW)
+    {
+      memcpy(row, row - image->widthStep, image->widthStep);
+      src++;
+      continue;
+    }
+    while (row < row_end)
+    {
+      if (src == end)
+      {
+        return IMG_READ_FAILURE;
+      }
+      int control = *src++;
+      if (control < RLE_MAX_PACKET)
+      {
+        size_t count = control + 1;
+        if (count > (size_t) (end - src) || count > (size_t) (row_end - row))
+        {
+          return IMG_READ_FAILURE;
+        }
+        memcpy(row, src, count);
+        src += count;
+        row += count;
+      }
+      else if (control > RLE_REPEAT_ROW)
+      {
+        size_t count = 257 - control;
+        if (src == end || count > (size_t) (row_end - row))
+        {
+          return IMG_READ_FAILURE;
+        }
+        memset(row, *src++, count);
+        row += count;
+      }
+      else
+      {
+        return IMG_READ_FAILURE;
+      }
+    }
+  }
+  return IMG_OK;
+}
+
+/*
+ * Reads the rest of a run-length encoded image from in, whose first line
+ * ("R5" or "R6") has been read, and closes in. Returns IMG_OK on success or
+ * an appropriate error code on failure.
+ */
+static image_error_t rle_read(FILE *in, char kind, image_t **out)
+{
+  int width, height, depth;
+  if (fscanf(in, "%d %d", &width, &height) != 2 || width <= 0 || height <= 0)
+  {
+    fclose(in);
+    return IMG_INVALID_SIZE;
+  }
+  if (fscanf(in, "%d", &depth) != 1 || depth != DEPTH)
+  {
+    fclose(in);
+    return IMG_INVALID_DEPTH;
+  }
+  fgetc(in);
+
+  // Read every packet at once, so that decoding is just memset and memcpy.
+  struct stat st;
+  long start = ftell(in);
+  if (start < 0 || fstat(fileno(in), &st) != 0 || st.st_size < start)
+  {
+    fclose(in);
+    return IMG_READ_FAILURE;
+  }
+  size_t size = st.st_size - start;
+  uint8_t *packets = malloc(size > 0 ? size : 1);
+  if (packets == NULL)
+  {
+    fclose(in);
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+  if (fread(packets, 1, size, in) != size)
+  {
+    free(packets);
+    fclose(in);
+    return IMG_READ_FAILURE;
+  }
+  fclose(in);
+
+  image_t *image;
+  image_error_t res = init_image(&image, width, height,
+                                 kind == '5' ? GRAY : RGB, depth);
+  if (res == IMG_OK)
+  {
+    res = rle_decode(image, packets, size);
+    if (res != IMG_OK)
+    {
+      image_free(image);
+    }
+  }
+  free(packets);
+  if (res == IMG_OK)
+  {
+    *out = image;
+  }
+  return res;
+}
+
+/*
+ * SWAR constants: every byte of a 64-bit word set to 0x01, '0' or 0x80.
+ */
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_ZEROS (SWAR_ONES * '0')
+#define SWAR_HIGH (SWAR_ONES * 0x80)
+
+/*
+ * Returns the number of leading decimal digits in the 8 bytes of word, which
+ * were loaded little-endian, so the first byte is the least significant.
+ */
+static int swar_digit_count(uint64_t word)
+{
+  uint64_t x = word ^ SWAR_ZEROS;   // digits become 0 to 9
+  // Each byte of x + 0x76 has its top bit set iff that byte is 10 or more;
+  // masking the top bits first keeps carries from crossing bytes.
+  uint64_t non_digit = (((x & ~SWAR_HIGH) + SWAR_ONES * 0x76) | x) & SWAR_HIGH;
+  return non_digit == 0 ? 8 : __builtin_ctzll(non_digit) / 8;
+}
+
+/*
+ * Returns the value of the first count (1 to 8) decimal digits in word, as
+ * loaded by swar_digit_count(). The digits are moved to the top of the word,
+ * leaving zeros in front, and then combined pairwise in three multiplies.
+ */
+static uint32_t swar_parse_digits(uint64_t word, int count)
+{
+  uint64_t x = (word ^ SWAR_ZEROS) << (8 * (8 - count));
+  x = (x * 10) + (x >> 8);   // pairs of digits in alternate bytes
+  x = (((x & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+       + (((x >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))))
+      >> 32;
+  return (uint32_t) x;
+}
+
+/*
+ * Parses the next whitespace-separated decimal value of a plain netpbm raster
+ * at *pos into value and advances *pos past it. Values of up to 8 digits are
+ * read 8 bytes at a time while that many bytes remain before end. Returns 0
+ * if something other than a value or whitespace is found first.
+ */
+static int parse_ascii_value(const char **pos, const char *end,
+                             uint32_t *value)
+{
+  const char *p = *pos;
+  while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r'))
+  {
+    p++;
+  }
+  if (end - p >= 8)
+  {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    int count = swar_digit_count(word);
+    if (count > 0 && count < 8)
+    {
+      *value = swar_parse_digits(word, count);
+      *pos = p + count;
+      return 1;
+    }
+  }
+  if (p == end || *p < '0' || *p > '9')
+  {
+    return 0;
+  }
+  uint64_t result = 0;
+  while (p < end && *p >= '0' && *p <= '9' && result <= UINT32_MAX)
+  {
+    result = result * 10 + (*p++ - '0');
+  }
+  if (result > UINT32_MAX)
+  {
+    return 0;
+  }
+  *value = result;
+  *pos = p;
+  return 1;
+}
+
+/*
+ * Decodes the raster of a plain PBM (P1) image from [pos, end) into image.
+ * Each pixel is a '0' (white) or '1' (black) character, optionally separated
+ * by whitespace.
+ */
+static image_error_t parse_ascii_bitmap(image_t *image, const char *pos,
+                                        const char *end)
+{
+  size_t pixels = (size_t) image->width * image->height;
+  for (size_t i = 0; i < pixels; i++)
+  {
+    while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\t'
+                         || *pos == '\r'))
+    {
+      pos++;
+    }
+    if (pos == end || (*pos != '0' && *pos != '1'))
+    {
+      return IMG_READ_FAILURE;
+    }
+    image->pixelsData[i] = *pos++ == '1' ? 0 : DEPTH;
+  }
+  return IMG_OK;
+}
+
+/*
+ * Decodes the raster of a plain PGM (P2) or PPM (P3) image from [pos, end)
+ * into image, rescaling samples from 0..max_value to 0..DEPTH.
+ */
+static image_error_t parse_ascii_samples(image_t *image, int max_value,
+                                         const char *pos, const char *end)
+{
+  uint8_t *scale = NULL;
+  if (max_value != DEPTH)
+  {
+    scale = malloc(max_value + 1);
+    if (scale == NULL)
+    {
+      return IMG_INSUFFICIENT_MEMORY;
+    }
+    for (int v = 0; v <= max_value; v++)
+    {
+      scale[v] = (v * DEPTH + max_value / 2) / max_value;
+    }
+  }
+
+  image_error_t res = IMG_OK;
+  size_t samples = (size_t) image->widthStep * image->height;
+  for (size_t i = 0; i < samples; i++)
+  {
+    uint32_t value;
+    if (!parse_ascii_value(&pos, end, &value) || value > (uint32_t) max_value)
+    {
+      res = IMG_READ_FAILURE;
+      break;
+    }
+    image->pixelsData[i] = scale != NULL ? scale[value] : value;
+  }
+  free(scale);
+  return res;
+}
+
+/*
+ * Reads a plain (ASCII) PBM, PGM or PPM image from in, whose first line has
+ * been read, and closes in. The whole file is mapped and parsed in place,
+ * with no stdio call per value. Plain PBM images are loaded as gray images.
+ * Returns IMG_OK on success or an appropriate error code on failure.
+ */
+static image_error_t ascii_read(FILE *in, image_t **out)
+{
+  struct stat st;
+  if (fstat(fileno(in), &st) != 0 || st.st_size < 2)
+  {
+    fclose(in);
+    return IMG_READ_FAILURE;
+  }
+  size_t size = st.st_size;
+  const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+  fclose(in);
+  if (text == MAP_FAILED)
+  {
+    return IMG_READ_FAILURE;
+  }
+  posix_madvise((void *) text, size, POSIX_MADV_SEQUENTIAL);
+
+  char kind = text[1];
+  const char *end = text + size;
+  int width, height, max_value = 1;
+  const char *pos = parse_header_field(text + 2, end, &width);
+  pos = pos ? parse_header_field(pos, end, &height) : NULL;
+  if (pos != NULL && kind != '1')
+  {
+    pos = parse_header_field(pos, end, &max_value);
+  }
+
+  image_t *image = NULL;
+  image_error_t res = IMG_OK;
+  if (pos == NULL || width <= 0 || height <= 0)
+  {
+    res = IMG_INVALID_SIZE;
+  }
+  else if (max_value <= 0 || max_value > 65535)
+  {
+    res = IMG_INVALID_DEPTH;
+  }
+  else
+  {
+    res = init_image(&image, width, height, kind == '3' ? RGB : GRAY, DEPTH);
+  }
+  if (res == IMG_OK)
+  {
+    res = kind == '1' ? parse_ascii_bitmap(image, pos, end)
+                      : parse_ascii_samples(image, max_value, pos, end);
+    if (res != IMG_OK)
+    {
+      image_free(image);
+    }
+  }
+  munmap((void *) text, size);
+  if (res == IMG_OK)
+  {
+    *out = image;
+  }
+  return res;
+}
+
+/*
+ * Attempts to read a PGM/PPM/PBM image stored in P1,P2,P3,P4,P5 OR P6 format,
+ * or a run-length encoded image (see rle_decode()), from the given file.
+ * Returns IMG_OK on success or an appropriate error code on failure. The
+ * parameter out will contain the loaded image if and only if the return value
+ * is IMG_OK.
+ */
+image_error_t image_read(const char *filename, image_t **out)
+{
+  image_t *image;
+
+  FILE *in;
+  char buffer[BUFFER_SIZE], c;
+  imageformat type;
+
+  //Open the file for reading.
+  in = fopen(filename, "rb");
+  if (!in)
+  {
+    return IMG_OPEN_FAILURE;
+  }
+
+  //Read in the image format; P6 and P4 is currently the only format supported.
+  if (fgets(buffer, BUFFER_SIZE, in) == NULL)
+  {
+    return IMG_MISSING_FORMAT;
+  }
+
+  if (buffer[0] == 'R' && (buffer[1] == '5' || buffer[1] == '6'))
+  {
+    return rle_read(in, buffer[1], out);
+  }
+
+  if (buffer[0] == 'P' && buffer[1] >= '1' && buffer[1] <= '3')
+  {
+    return ascii_read(in, out);
+  }
+
+  if (buffer[0] != 'P' && ( buffer[1] != '4' || buffer[1] != '6'
+    || buffer[1] == '5' ))
+  {
+    return IMG_INVALID_FORMAT;
+  }
+
+  /*
+   * Allocate space for the image header.
+   */
+  image = malloc(sizeof(image_t));
+
+  if (image == NULL)
+  {
+      return IMG_INSUFFICIENT_MEMORY;
+  }
+  image->mapping = NULL;
+  image->layout = IMAGE_ROW_MAJOR;
+
+  if (buffer[1] == '4')
+  {
+    image->nChannels = 1;
+    image->depth = 255;
+    type = PBM_FORMAT;
+  }
+  else if (buffer[1] == '5')
+  {
+    image->nChannels = 1;
+    image->depth = 255;
+    type = PGM_FORMAT;
+  }
+  else
+  {
+    image->nChannels = 3;
+    type = PPM_FORMAT;
+  }
+
+  c = fgetc(in);
+  while (c == '#')
+  {
+    while (fgetc(in) != '\n') { }
+    c = fgetc(in);
+  }
+
+  ungetc(c, in);
+
+  //Read the image's size information.
+  if (fscanf(in, "%d %d", &image->width, &image->height) != 2)
+  {
+    return IMG_INVALID_SIZE;
+  }
+
+  //Add the widthstep information to allow to move between array
+  image->widthStep = image->nChannels * image->width;
+
+  //Read and check the image's RGB component depth in PPM image.
+  if(type == PPM_FORMAT)
+  {
+    if ((fscanf(in, "%d", &image->depth) != 1) || image->depth != DEPTH)
+    {
+      return IMG_INVALID_DEPTH;
+    }
+  }
+  else if (type == PGM_FORMAT)
+  {
+    int max_grey;
+    fscanf(in, "%d", &max_grey);
+  }
+
+  // Skip over any remaining cruft preceding the pixel data.
+  while (fgetc(in) != '\n') { }
+
+  // Allocate and read pixel data.
+  image->pixelsData = malloc(image->width * image->height *
+                             image->nChannels * sizeof(uint8_t));
+  if (!image->pixelsData)
+  {
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+
+  if (fread(image->pixelsData,
+    image->nChannels * image->width * sizeof(uint8_t),
+    image->height, in) != image->height)
+  {
+    image_free(image);
+    return IMG_READ_FAILURE;
+  }
+
+  fclose(in);
+  *out = image;
+  return IMG_OK;
+}
+
+/*
+ * The header of a binary PGM (P5) or PPM (P6) file. The pixel data starts
+ * offset bytes into the file.
+ */
+typedef struct
+{
+  int width, height;
+  int nChannels;
+  int depth;
+  size_t offset;
+} binary_header_t;
+
+/*
+ * Reads and parses the header of a binary PGM/PPM file from fd with a single
+ * read, leaving the file position undefined. Returns IMG_INVALID_FORMAT if
+ * the file is in some other format or its header is longer than
+ * MAPPED_HEADER_SIZE, otherwise IMG_OK or an appropriate error code.
+ */
+static image_error_t read_binary_header(int fd, binary_header_t *header)
+{
+  char buffer[MAPPED_HEADER_SIZE];
+  ssize_t length = read(fd, buffer, sizeof(buffer));
+  if (length < 2)
+  {
+    return IMG_MISSING_FORMAT;
+  }
+  if (buffer[0] != 'P' || (buffer[1] != '5' && buffer[1] != '6'))
+  {
+    return IMG_INVALID_FORMAT;
+  }
+
+  const char *end = buffer + length;
+  const char *pos = parse_header_field(buffer + 2, end, &header->width);
+  pos = pos ? parse_header_field(pos, end, &header->height) : NULL;
+  pos = pos ? parse_header_field(pos, end, &header->depth) : NULL;
+  if (pos == NULL)
+  {
+    return IMG_INVALID_FORMAT;
+  }
+  if (header->width <= 0 || header->height <= 0)
+  {
+    return IMG_INVALID_SIZE;
+  }
+  if (header->depth != DEPTH)
+  {
+    return IMG_INVALID_DEPTH;
+  }
+
+  // A single whitespace character separates the header from the pixels.
+  header->offset = pos + 1 - buffer;
+  header->nChannels = buffer[1] == '5' ? GRAY : RGB;
+  return IMG_OK;
+}
+
+/*
+ * Attempts to read a binary PGM (P5) or PPM (P6) image without copying its
+ * pixels: the header is parsed from a single read and the file is then
+ * mapped, with pixelsData pointing into the mapping. The mapping is private
+ * copy-on-write, so the image can be modified freely without affecting the
+ * file, and image_free() unmaps it. Other formats, and binary images whose
+ * maximum value is not DEPTH, are read with image_read() as before.
+ * Returns IMG_OK on success or an appropriate error code on failure.
+ */
+image_error_t image_read_mapped(const char *filename, image_t **out)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+  {
+    return IMG_OPEN_FAILURE;
+  }
+
+  binary_header_t header;
+  image_error_t res = read_binary_header(fd, &header);
+  if (res == IMG_INVALID_FORMAT || res == IMG_INVALID_DEPTH)
+  {
+    close(fd);
+    return image_read(filename, out);
+  }
+  if (res != IMG_OK)
+  {
+    close(fd);
+    return res;
+  }
+
+  size_t size = header.offset
+              + (size_t) header.width * header.height * header.nChannels;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < size)
+  {
+    close(fd);
+    return IMG_READ_FAILURE;
+  }
+
+  image_t *image = malloc(sizeof(image_t));
+  if (image == NULL)
+  {
+    close(fd);
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+  void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    free(image);
+    return IMG_READ_FAILURE;
+  }
+
+  image->width = header.width;
+  image->height = header.height;
+  image->nChannels = header.nChannels;
+  image->widthStep = header.width * header.nChannels;
+  image->depth = header.depth;
+  image->pixelsData = (uint8_t *) mapping + header.offset;
+  image->mapping = mapping;
+  image->mappingSize = size;
+  image->layout = IMAGE_ROW_MAJOR;
+  *out = image;
+  return IMG_OK;
+}
+
+/*
+ * Allocates a stream for an image of the given size whose buffer holds
+ * band_rows rows, and attaches it to file with a STREAM_BUFFER_SIZE buffer.
+ */
+static image_error_t stream_allocate(image_stream_t **out, FILE *file,
+                                     int width, int height, int nChannels,
+                                     int band_rows)
+{
+  image_stream_t *stream = malloc(sizeof(image_stream_t));
+  if (stream == NULL)
+  {
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+  stream->file = file;
+  stream->writable = 0;
+  stream->width = width;
+  stream->height = height;
+  stream->nChannels = nChannels;
+  stream->widthStep = width * nChannels;
+  stream->depth = DEPTH;
+  stream->row = 0;
+  stream->bandRows = band_rows > 0 ? band_rows : 1;
+  stream->buffer = malloc((size_t) stream->bandRows * stream->widthStep);
+  if (stream->buffer == NULL)
+  {
+    free(stream);
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+  setvbuf(file, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+  *out = stream;
+  return IMG_OK;
+}
+
+/*
+ * Opens a binary PGM (P5) or PPM (P6) image for reading band_rows rows at a
+ * time with image_stream_read(). Only one band is ever held in memory, so
+ * images of any height can be processed. Returns IMG_OK on success or an
+ * appropriate error code on failure.
+ */
+image_error_t image_stream_open(const char *filename, int band_rows,
+                                image_stream_t **out)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+  {
+    return IMG_OPEN_FAILURE;
+  }
+
+  binary_header_t header;
+  image_error_t res = read_binary_header(fd, &header);
+  if (res != IMG_OK)
+  {
+    close(fd);
+    return res;
+  }
+
+  // The pixels are read once, front to back.
+  posix_fadvise(fd, header.offset, 0, POSIX_FADV_SEQUENTIAL);
+  FILE *file = NULL;
+  if (lseek(fd, header.offset, SEEK_SET) < 0
+      || (file = fdopen(fd, "rb")) == NULL)
+  {
+    close(fd);
+    return IMG_READ_FAILURE;
+  }
+
+  res = stream_allocate(out, file, header.width, header.height,
+                        header.nChannels, band_rows);
+  if (res != IMG_OK)
+  {
+    fclose(file);
+  }
+  return res;
+}
+
+/*
+ * Reads the next band of up to bandRows rows into stream->buffer and sets
+ * count to the number of rows read, which is 0 once every row has been read.
+ * The first row of the band is row stream->row - count of the image.
+ */
+image_error_t image_stream_read(image_stream_t *stream, int *count)
+{
+  int rows = stream->height - stream->row;
+  if (rows > stream->bandRows)
+  {
+    rows = stream->bandRows;
+  }
+  *count = 0;
+  if (rows > 0
+      && fread(stream->buffer, stream->widthStep, rows, stream->file) != rows)
+  {
+    return IMG_READ_FAILURE;
+  }
+  stream->row += rows;
+  *count = rows;
+  return IMG_OK;
+}
+
+/*
+ * Creates a binary PGM (GRAY) or PPM (RGB) image of the given size to be
+ * written incrementally with image_stream_write(). stream->buffer holds
+ * band_rows rows and may be used to assemble them. Returns IMG_OK on success
+ * or an appropriate error code on failure.
+ */
+image_error_t image_stream_create(const char *filename, int width, int height,
+                                  int nChannels, int band_rows,
+                                  image_stream_t **out)
+{
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL)
+  {
+    return IMG_OPEN_FAILURE;
+  }
+  image_error_t res = stream_allocate(out, file, width, height, nChannels,
+                                      band_rows);
+  if (res != IMG_OK)
+  {
+    fclose(file);
+    return res;
+  }
+  (*out)->writable = 1;
+  if (fprintf(file, "P%c\n%d %d\n%d\n", nChannels == GRAY ? '5' : '6',
+              width, height, DEPTH) < 0)
+  {
+    image_stream_close(*out);
+    *out = NULL;
+    return IMG_WRITE_FAILURE;
+  }
+  return IMG_OK;
+}
+
+/*
+ * Appends count rows of widthStep bytes each to an image opened with
+ * image_stream_create().
+ */
+image_error_t image_stream_write(image_stream_t *stream, const uint8_t *rows,
+                                 int count)
+{
+  assert(stream->row + count <= stream->height);
+
+  if (count > 0 && fwrite(rows, stream->widthStep, count, stream->file)
+                   != count)
+  {
+    return IMG_WRITE_FAILURE;
+  }
+  stream->row += count;
+  return IMG_OK;
+}
+
+/*
+ * Closes a stream and frees its memory. For a stream being written, returns
+ * IMG_WRITE_FAILURE unless every row has been written successfully.
+ */
+image_error_t image_stream_close(image_stream_t *stream)
+{
+  image_error_t res = IMG_OK;
+  if (fclose(stream->file) != 0
+      || (stream->writable && stream->row != stream->height))
+  {
+    res = IMG_WRITE_FAILURE;
+  }
+  free(stream->buffer);
+  free(stream);
+  return res;
+}
+
+/*
+ * Returns how many of the length pixels running right from column x are
+ * stored contiguously, nChannels bytes apart, in any row of image.
+ */
+static int contiguous_run(const image_t *image, int x, int length)
+{
+  if (image->layout == IMAGE_TILED)
+  {
+    int run = TILE_SIZE - (x & (TILE_SIZE - 1));
+    return run < length ? run : length;
+  }
+  return length;
+}
+
+/*
+ * Returns the number of bytes of pixel data an image of the given size and
+ * layout needs.
+ */
+static size_t layout_size(const image_t *image, image_layout_t layout)
+{
+  if (layout == IMAGE_TILED)
+  {
+    size_t tiles_x = (image->width + TILE_SIZE - 1) >> TILE_SHIFT;
+    size_t tiles_y = (image->height + TILE_SIZE - 1) >> TILE_SHIFT;
+    return tiles_x * tiles_y * TILE_SIZE * TILE_SIZE * image->nChannels;
+  }
+  return (size_t) image->widthStep * image->height;
+}
+
+/*
+ * Returns row y of image in row-major order: the row itself for row-major
+ * images, otherwise a copy gathered into buffer, which holds widthStep bytes.
+ */
+static const uint8_t *row_major_row(image_t *image, int y, uint8_t *buffer)
+{
+  if (image->layout == IMAGE_ROW_MAJOR)
+  {
+    return image_row(image, y);
+  }
+  for (int x = 0; x < image->width; )
+  {
+    int run = contiguous_run(image, x, image->width - x);
+    memcpy(buffer + x * image->nChannels,
+           image->pixelsData + image_offset(image, x, y),
+           (size_t) run * image->nChannels);
+    x += run;
+  }
+  return buffer;
+}
+
+/*
+ * Prepares runs to be read into.
+ */
+void image_runs_init(image_runs_t *runs)
+{
+  runs->width = 0;
+  runs->y0 = 0;
+  runs->height = 0;
+  runs->runs = NULL;
+  runs->nRuns = 0;
+  runs->runCapacity = 0;
+  runs->first = NULL;
+  runs->count = NULL;
+  runs->rowCapacity = 0;
+  runs->buffer = NULL;
+  runs->bufferSize = 0;
+}
+
+/*
+ * Returns the first channel of row y of image as width contiguous bytes: the
+ * row itself for row-major gray images, otherwise a copy in values, gathered
+ * through scratch, which holds widthStep bytes.
+ */
+static const uint8_t *first_channel_row(image_t *image, int y,
+                                        uint8_t *values, uint8_t *scratch)
+{
+  if (image->nChannels == 1)
+  {
+    return row_major_row(image, y, values);
+  }
+  const uint8_t *row = row_major_row(image, y, scratch);
+  for (int x = 0; x < image->width; x++)
+  {
+    values[x] = row[x * image->nChannels];
+  }
+  return values;
+}
+
+/*
+ * Reads rows y0 to y0 + height - 1 of image into runs, in one pass over each
+ * row with kernel_find_difference(). Rows equal to the row above, found with
+ * kernel_compare(), share its runs. Returns IMG_OK on success, or
+ * IMG_INSUFFICIENT_MEMORY, after which runs can only be freed.
+ */
+image_error_t image_runs_read(image_runs_t *runs, image_t *image, int y0,
+                              int height)
+{
+  assert(image != NULL);
+  assert(y0 >= 0 && height >= 0 && y0 + height <= image->height);
+
+  int width = image->width;
+  size_t buffer_size = 2 * (size_t) width + image->widthStep;
+  if (runs->rowCapacity < height)
+  {
+    free(runs->first);
+    free(runs->count);
+    runs->first = malloc(height * sizeof(size_t));
+    runs->count = malloc(height * sizeof(int));
+    if (runs->first == NULL || runs->count == NULL)
+    {
+      return IMG_INSUFFICIENT_MEMORY;
+    }
+    runs->rowCapacity = height;
+  }
+  if (runs->bufferSize < buffer_size)
+  {
+    free(runs->buffer);
+    runs->buffer = malloc(buffer_size);
+    if (runs->buffer == NULL)
+    {
+      return IMG_INSUFFICIENT_MEMORY;
+    }
+    runs->bufferSize = buffer_size;
+  }
+  runs->width = width;
+  runs->y0 = y0;
+  runs->height = height;
+  runs->nRuns = 0;
+
+  uint8_t *values[2] = {runs->buffer, runs->buffer + width};
+  uint8_t *scratch = runs->buffer + 2 * (size_t) width;
+  const uint8_t *above = NULL;
+  for (int i = 0; i < height; i++)
+  {
+    const uint8_t *row = first_channel_row(image, y0 + i, values[i & 1],
+                                           scratch);
+    if (above != NULL && kernel_compare(row, above, width) == (size_t) width)
+    {
+      runs->first[i] = runs->first[i - 1];
+      runs->count[i] = runs->count[i - 1];
+      above = row;
+      continue;
+    }
+    above = row;
+
+    if (runs->runCapacity - runs->nRuns < (size_t) width)
+    {
+      size_t capacity = 2 * runs->runCapacity + width;
+      image_run_t *grown = realloc(runs->runs, capacity * sizeof(image_run_t));
+      if (grown == NULL)
+      {
+        return IMG_INSUFFICIENT_MEMORY;
+      }
+      runs->runs = grown;
+      runs->runCapacity = capacity;
+    }
+    runs->first[i] = runs->nRuns;
+    for (int x = 0; x < width; )
+    {
+      image_run_t *run = &runs->runs[runs->nRuns++];
+      run->start = x;
+      run->value = row[x];
+      run->length = kernel_find_difference(row + x, width - x, row[x]);
+      x += run->length;
+    }
+    runs->count[i] = runs->nRuns - runs->first[i];
+  }
+  return IMG_OK;
+}
+
+/*
+ * Reads the next band of stream with image_stream_read() into runs, setting
+ * count as it does. runs->y0 is the row of the image the band starts at, so
+ * only one band of pixels is held whatever the height of the image. Returns
+ * IMG_OK on success or an appropriate error code on failure.
+ */
+image_error_t image_runs_read_stream(image_runs_t *runs,
+                                     image_stream_t *stream, int *count)
+{
+  image_error_t res = image_stream_read(stream, count);
+  if (res != IMG_OK || *count == 0)
+  {
+    return res;
+  }
+  image_t band = {stream->width, *count, stream->nChannels, stream->widthStep,
+                  stream->depth, stream->buffer, NULL, 0, IMAGE_ROW_MAJOR};
+  res = image_runs_read(runs, &band, 0, *count);
+  runs->y0 = stream->row - *count;
+  return res;
+}
+
+/*
+ * Deallocates the arrays of runs.
+ */
+void image_runs_free(image_runs_t *runs)
+{
+  free(runs->runs);
+  free(runs->first);
+  free(runs->count);
+  free(runs->buffer);
+  image_runs_init(runs);
+}
+
+/*
+ * Rearranges the pixels of image into the given layout, allocating a new
+ * pixel buffer. Loaders produce row-major images and writers accept either,
+ * so this converts at load and save time. Returns IMG_OK on success, or
+ * IMG_INSUFFICIENT_MEMORY with image unchanged.
+ */
+image_error_t image_set_layout(image_t *image, image_layout_t layout)
+{
+  if (image->layout == layout)
+  {
+    return IMG_OK;
+  }
+  image_t converted = *image;
+  converted.layout = layout;
+  converted.mapping = NULL;
+  converted.pixelsData = calloc(layout_size(image, layout), sizeof(uint8_t));
+  if (converted.pixelsData == NULL)
+  {
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+  for (int y = 0; y < image->height; y++)
+  {
+    for (int x = 0; x < image->width; )
+    {
+      int run = contiguous_run(image, x, image->width - x);
+      run = contiguous_run(&converted, x, run);
+      memcpy(converted.pixelsData + image_offset(&converted, x, y),
+             image->pixelsData + image_offset(image, x, y),
+             (size_t) run * image->nChannels);
+      x += run;
+    }
+  }
+  if (image->mapping != NULL)
+  {
+    munmap(image->mapping, image->mappingSize);
+  }
+  else
+  {
+    free(image->pixelsData);
+  }
+  *image = converted;
+  return IMG_OK;
+}
+
+/*
+ * Writes the supplied image to the given file, converting gray images written
+ * as PPM to RGB and RGB images written as PGM to gray. Returns IMG_OK on
+ * success, or an appropriate error code on failure.
+ */
+image_error_t image_write(const char *filename, image_t *image,
+                          imageformat type)
+{
+  FILE *out;
+
+  // Open file for output.
+  out = fopen(filename, "wb");
+  if (!out)
+  {
+      return IMG_OPEN_FAILURE;
+  }
+
+  //Print the header.
+  if(type == PPM_FORMAT)
+  {
+    fprintf(out, "P6\n");
+    fprintf(out, "%d %d\n", image->width, image->height);
+    fprintf(out, "%d\n", image->depth);
+  }
+  else if (type == PBM_FORMAT)
+  {
+    fprintf(out, "P4\n");
+    fprintf(out, "%d %d\n", image->width, image->height);
+  }
+  else if (type == PGM_FORMAT)
+  {
+    fprintf(out, "P5\n");
+    fprintf(out, "%d %d\n", image->width, image->height);
+    fprintf(out, "%d\n", image->depth);
+  }
+  else
+  {
+    fclose(out);
+    return IMG_INVALID_FORMAT;
+  }
+
+  //Print the pixel data.
+  // Rows are converted to the channels of the format: a gray image written as
+  // PPM is expanded to RGB, and an RGB image written as PGM is reduced to its
+  // luma.
+  int channels = type == PPM_FORMAT ? RGB
+                 : type == PGM_FORMAT ? GRAY : image->nChannels;
+  if (image->layout == IMAGE_TILED || channels != image->nChannels)
+  {
+    size_t row_size = (size_t) image->width * channels;
+    uint8_t *buffer = malloc(image->widthStep + row_size);
+    uint8_t *converted = buffer != NULL ? buffer + image->widthStep : NULL;
+    int ok = buffer != NULL;
+    for (int y = 0; ok && y < image->height; y++)
+    {
+      const uint8_t *row = row_major_row(image, y, buffer);
+      if (channels == RGB && image->nChannels == GRAY)
+      {
+        kernel_gray_to_rgb(converted, row, image->width);
+        row = converted;
+      }
+      else if (channels == GRAY && image->nChannels == RGB)
+      {
+        kernel_rgb_to_gray(converted, row, image->width);
+        row = converted;
+      }
+      ok = fwrite(row, row_size, 1, out);
+    }
+    free(buffer);
+    if (!ok)
+    {
+      fclose(out);
+      return IMG_WRITE_FAILURE;
+    }
+  }
+  else if (!fwrite(image->pixelsData, image->nChannels * image->width,
+    image->height, out))
+  {
+    image_free(image);
+    return IMG_WRITE_FAILURE;
+  }
+
+  fclose(out);
+  return IMG_OK;
+}
+
+/*
+ * Appends the PackBits packets of the length bytes at src to dst and returns
+ * the number of bytes appended, at most length + length / RLE_MAX_PACKET + 1.
+ * Runs of three or more equal bytes become repeat packets.
+ */
+static size_t rle_encode_row(uint8_t *dst, const uint8_t *src, size_t length)
+{
+  uint8_t *start = dst;
+  size_t literal = 0;   // start of the pending literal bytes
+  size_t i = 0;
+  while (i <= length)
+  {
+    size_t run = i < length
+               ? kernel_find_difference(src + i, length - i, src[i]) : 0;
+    if (run >= 3 || i == length)
+    {
+      // Flush the literal bytes before the run.
+      while (literal < i)
+      {
+        size_t count = i - literal < RLE_MAX_PACKET ? i - literal
+                                                     : RLE_MAX_PACKET;
+        *dst++ = count - 1;
+        memcpy(dst, src + literal, count);
+        dst += count;
+        literal += count;
+      }
+      if (i == length)
+      {
+        break;
+      }
+      // A tail of one or two bytes is cheaper as a literal.
+      while (run >= 3)
+      {
+        size_t count = run < RLE_MAX_PACKET ? run : RLE_MAX_PACKET;
+        *dst++ = 257 - count;
+        *dst++ = src[i];
+        i += count;
+        run -= count;
+      }
+      literal = i;
+      i += run;
+    }
+    else
+    {
+      i += run;
+    }
+  }
+  return dst - start;
+}
+
+/*
+ * Writes image to filename in the run-length encoded format described at
+ * rle_decode(), which is far smaller than P5/P6 for images made of flat
+ * regions. image_read() detects the format. Returns IMG_OK on success or an
+ * appropriate error code on failure.
+ */
+image_error_t image_write_rle(const char *filename, image_t *image)
+{
+  size_t row_size = image->widthStep;
+  uint8_t *packets = malloc(row_size + row_size / RLE_MAX_PACKET + 1);
+  // Two rows gathered from tiled images: the current one and the one above.
+  uint8_t *rows = malloc(2 * row_size);
+  if (packets == NULL || rows == NULL)
+  {
+    free(packets);
+    free(rows);
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+  FILE *out = fopen(filename, "wb");
+  if (out == NULL)
+  {
+    free(packets);
+    free(rows);
+    return IMG_OPEN_FAILURE;
+  }
+  setvbuf(out, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+
+  int ok = fprintf(out, "R%c\n%d %d\n%d\n",
+                   image->nChannels == GRAY ? '5' : '6',
+                   image->width, image->height, image->depth) > 0;
+  const uint8_t *above = NULL;
+  for (int y = 0; ok && y < image->height; y++)
+  {
+    const uint8_t *row = row_major_row(image, y, rows + (y & 1) * row_size);
+    size_t size;
+    if (y > 0 && kernel_compare(row, above, row_size) == row_size)
+    {
+      packets[0] = RLE_REPEAT_ROW;
+      size = 1;
+    }
+    else
+    {
+      size = rle_encode_row(packets, row, row_size);
+    }
+    ok = fwrite(packets, 1, size, out) == size;
+    above = row;
+  }
+  free(packets);
+  free(rows);
+  if (fclose(out) != 0 || !ok)
+  {
+    return IMG_WRITE_FAILURE;
+  }
+  return IMG_OK;
+}
+
+/*
+ * creates an image with width and height size, nChannels and depth pixel value.
+ * It is using the image_error_t enum types provided in image.h
+ */
+image_error_t init_image(image_t** dst, int width, int height, int nChannels,
+                         int depth)
+{
+    image_t *image = NULL;
+    image = malloc(sizeof(image_t));
+
+    if (image == NULL)
+    {
+        return IMG_INSUFFICIENT_MEMORY;
+    }
+
+    image->nChannels = nChannels;
+    image->depth = depth;
+    image->width = width;
+    image->height = height;
+    image->widthStep = nChannels * width;
+    image->mapping = NULL;
+    image->layout = IMAGE_ROW_MAJOR;
+    image->pixelsData = calloc(image->widthStep * image->height,
+                               sizeof(uint8_t));
+
+    if (image->pixelsData == NULL)
+    {
+        return IMG_INSUFFICIENT_MEMORY;
+    }
+
+    *dst = image;
+    return IMG_OK;
+}
+/*
+ * Writes "value" to the pixel (x,y) of the image argument.
+ */
+void set_pixel(image_t *dst, int x, int y, uint8_t value)
+{
+  assert(dst != NULL);
+  assert(x >= 0);
+  assert(y >= 0);
+  assert(x < dst->width);
+  assert(y < dst->height);
+
+  dst->pixelsData[image_offset(dst, x, y)] = value;
+}
+
+/*
+ * Reads the pixel intensity from location (x,y).
+ */
+uint8_t get_pixel(image_t *src, int x, int y)
+{
+  assert(src != NULL);
+  assert(x >= 0);
+  assert(y >= 0);
+  assert(x < src->width);
+  assert(y < src->height);
+
+  return src->pixelsData[image_offset(src, x, y)];
+}
+
+/*
+ * Returns a pointer to the first pixel of row y of a row-major image. Pixel
+ * (x, y) is at offset x * nChannels from it. The row is checked once here, so
+ * callers can walk it without the per-pixel checks of get_pixel() and
+ * set_pixel().
+ */
+uint8_t *image_row(image_t *image, int y)
+{
+  assert(image != NULL);
+  assert(image->layout == IMAGE_ROW_MAJOR);
+  assert(y >= 0);
+  assert(y < image->height);
+
+  return image->pixelsData + (size_t) y * image->widthStep;
+}
+
+/*
+ * Writes "value" to the length pixels starting at (x,y) and running right
+ * along the row. Only the first channel of each pixel is written, as with
+ * set_pixel().
+ */
+void image_fill_span(image_t *dst, int x, int y, int length, uint8_t value)
+{
+  assert(x >= 0);
+  assert(length >= 0);
+  assert(x + length <= dst->width);
+  assert(y >= 0 && y < dst->height);
+
+  while (length > 0)
+  {
+    int run = contiguous_run(dst, x, length);
+    uint8_t *pixel = dst->pixelsData + image_offset(dst, x, y);
+    if (dst->nChannels == 1)
+    {
+      memset(pixel, value, run);
+    }
+    else
+    {
+      for (int i = 0; i < run; i++)
+      {
+        pixel[i * dst->nChannels] = value;
+      }
+    }
+    x += run;
+    length -= run;
+  }
+}
+
+/*
+ * Writes "value" to every pixel of the width x height rectangle whose top-left
+ * corner is (x,y).
+ */
+void image_fill_rect(image_t *dst, int x, int y, int width, int height,
+                     uint8_t value)
+{
+  if (dst->layout == IMAGE_TILED)
+  {
+    assert(y >= 0 && height >= 0 && y + height <= dst->height);
+    for (int j = 0; j < height; j++)
+    {
+      image_fill_span(dst, x, y + j, width, value);
+    }
+    return;
+  }
+  image_view_t view = image_view(dst);
+  view = image_view_crop(&view, x, y, width, height);
+  image_view_fill(&view, value);
+}
+
+/*
+ * Returns 1 if the length pixels starting at (x,y) and running right along the
+ * row all have intensity "value", otherwise 0.
+ */
+int image_row_equals(image_t *src, int x, int y, int length, uint8_t value)
+{
+  assert(x >= 0);
+  assert(length >= 0);
+  assert(x + length <= src->width);
+
+  assert(y >= 0 && y < src->height);
+
+  while (length > 0)
+  {
+    int run = contiguous_run(src, x, length);
+    const uint8_t *pixel = src->pixelsData + image_offset(src, x, y);
+    if (src->nChannels == 1 && run == TILE_SIZE)
+    {
+      // A whole row of a gray tile is one 8-byte word.
+      uint64_t word;
+      memcpy(&word, pixel, sizeof(word));
+      if (word != value * 0x0101010101010101ULL)
+      {
+        return 0;
+      }
+    }
+    else if (src->nChannels == 1)
+    {
+      if (kernel_find_difference(pixel, run, value) != (size_t) run)
+      {
+        return 0;
+      }
+    }
+    else
+    {
+      for (int i = 0; i < run; i++)
+      {
+        if (pixel[i * src->nChannels] != value)
+        {
+          return 0;
+        }
+      }
+    }
+    x += run;
+    length -= run;
+  }
+  return 1;
+}
+
+/*
+ * Returns a view of the whole of image.
+ */
+image_view_t image_view(image_t *image)
+{
+  assert(image != NULL);
+  assert(image->layout == IMAGE_ROW_MAJOR);
+
+  image_view_t view;
+  view.pixels = image->pixelsData;
+  view.width = image->width;
+  view.height = image->height;
+  view.nChannels = image->nChannels;
+  view.stride = image->widthStep;
+  return view;
+}
+
+/*
+ * Returns a view of the width x height rectangle of view whose top-left
+ * corner is (x,y). The rectangle must lie inside view.
+ */
+image_view_t image_view_crop(const image_view_t *view, int x, int y,
+                             int width, int height)
+{
+  assert(x >= 0 && width >= 0 && x + width <= view->width);
+  assert(y >= 0 && height >= 0 && y + height <= view->height);
+
+  image_view_t crop = *view;
+  crop.pixels = view->pixels + y * view->stride + x * view->nChannels;
+  crop.width = width;
+  crop.height = height;
+  return crop;
+}
+
+/*
+ * Returns a pointer to the first pixel of row y of view, as image_row() does
+ * for images.
+ */
+uint8_t *image_view_row(const image_view_t *view, int y)
+{
+  assert(y >= 0);
+  assert(y < view->height);
+
+  return view->pixels + y * view->stride;
+}
+
+/*
+ * Returns the first channel of pixel (x,y) of view.
+ */
+uint8_t image_view_get_pixel(const image_view_t *view, int x, int y)
+{
+  assert(x >= 0);
+  assert(x < view->width);
+
+  return image_view_row(view, y)[x * view->nChannels];
+}
+
+/*
+ * Writes "value" to the first channel of pixel (x,y) of view.
+ */
+void image_view_set_pixel(const image_view_t *view, int x, int y,
+                          uint8_t value)
+{
+  assert(x >= 0);
+  assert(x < view->width);
+
+  image_view_row(view, y)[x * view->nChannels] = value;
+}
+
+/*
+ * Writes "value" to the first channel of every pixel of view.
+ */
+void image_view_fill(const image_view_t *view, uint8_t value)
+{
+  if (view->nChannels == 1)
+  {
+    kernel_fill(view->pixels, view->stride, view->width, view->height, value);
+    return;
+  }
+  for (int y = 0; y < view->height; y++)
+  {
+    uint8_t *row = image_view_row(view, y);
+    for (int x = 0; x < view->width; x++)
+    {
+      row[x * view->nChannels] = value;
+    }
+  }
+}
+
+/*
+ * Downsamples rows [first, last) of dst from src, which is twice its size,
+ * averaging each 2x2 block of src with rounding. Pixels past the right or
+ * bottom edge of an odd-sized src are taken from the edge.
+ */
+static void downsample_rows(image_t *dst, image_t *src, int first, int last)
+{
+  int n = src->nChannels;
+  int full = src->width / 2;
+  for (int y = first; y < last; y++)
+  {
+    const uint8_t *r0 = image_row(src, 2 * y);
+    const uint8_t *r1 = image_row(src, 2 * y + 1 < src->height ? 2 * y + 1
+                                                               : 2 * y);
+    uint8_t *out = image_row(dst, y);
+    if (n == 1)
+    {
+      kernel_downsample(out, r0, r1, full);
+    }
+    else
+    {
+      for (int i = 0; i < full * n; i++)
+      {
+        int c = i % n;
+        int x = i - c;
+        out[i] = (r0[2 * x + c] + r0[2 * x + n + c]
+                  + r1[2 * x + c] + r1[2 * x + n + c] + 2) >> 2;
+      }
+    }
+    if (full < dst->width)
+    {
+      for (int c = 0; c < n; c++)
+      {
+        int last_x = (src->width - 1) * n + c;
+        out[full * n + c] = (r0[last_x] + r1[last_x] + 1) >> 1;
+      }
+    }
+  }
+}
+
+/*
+ * State shared by the threads that build a pyramid. Level 0 is the input
+ * image; level i + 1 is level i downsampled by two in each direction.
+ */
+typedef struct pyramid
+{
+  const char *basename;
+  image_t **levels;
+  int nLevels;
+  int nThreads;
+  pthread_barrier_t barrier;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  int started;
+  struct pyramid_worker *workers;
+  image_error_t result;
+} pyramid_t;
+
+/*
+ * A 1/nThreads share of the rows of each level. threaded is set if the share
+ * has a thread of its own; worker 0 builds the shares that do not.
+ */
+typedef struct pyramid_worker
+{
+  pyramid_t *pyramid;
+  int index;
+  pthread_t thread;
+  int threaded;
+} pyramid_worker_t;
+
+/*
+ * Allocates the given level of the pyramid, leaving it NULL on failure.
+ */
+static void pyramid_allocate(pyramid_t *pyramid, int level)
+{
+  image_t *src = pyramid->levels[level - 1];
+  image_error_t res = init_image(&pyramid->levels[level],
+                                 (src->width + 1) / 2, (src->height + 1) / 2,
+                                 src->nChannels, src->depth);
+  if (res != IMG_OK)
+  {
+    pyramid->levels[level] = NULL;
+    pyramid->result = res;
+  }
+}
+
+/*
+ * Downsamples the rows of the given level that belong to share index.
+ */
+static void pyramid_share(pyramid_t *pyramid, int level, int index)
+{
+  image_t *dst = pyramid->levels[level];
+  int first = (long) dst->height * index / pyramid->nThreads;
+  int last = (long) dst->height * (index + 1) / pyramid->nThreads;
+  downsample_rows(dst, pyramid->levels[level - 1], first, last);
+}
+
+/*
+ * Builds every level of the pyramid, taking the worker's share of the rows of
+ * each, and worker 0 also the shares of workers whose thread did not start.
+ * Threads wait until every thread has been started, so that the barrier
+ * counts only those that were. Once a level is complete worker 0 allocates
+ * the next one, then writes the level to disk and frees the level before it
+ * while the others go on to the next level.
+ */
+static void *pyramid_work(void *arg)
+{
+  pyramid_worker_t *worker = arg;
+  pyramid_t *pyramid = worker->pyramid;
+  pthread_mutex_lock(&pyramid->lock);
+  while (!pyramid->started)
+  {
+    pthread_cond_wait(&pyramid->ready, &pyramid->lock);
+  }
+  pthread_mutex_unlock(&pyramid->lock);
+
+  for (int level = 1; level < pyramid->nLevels; level++)
+  {
+    image_t *dst = pyramid->levels[level];
+    if (dst == NULL)
+    {
+      break;
+    }
+    pyramid_share(pyramid, level, worker->index);
+    for (int i = 1; worker->index == 0 && i < pyramid->nThreads; i++)
+    {
+      if (!pyramid->workers[i].threaded)
+      {
+        pyramid_share(pyramid, level, i);
+      }
+    }
+    pthread_barrier_wait(&pyramid->barrier);
+    if (worker->index == 0 && level + 1 < pyramid->nLevels)
+    {
+      pyramid_allocate(pyramid, level + 1);
+    }
+    pthread_barrier_wait(&pyramid->barrier);
+
+    if (worker->index == 0)
+    {
+      if (level > 1)
+      {
+        image_free(pyramid->levels[level - 1]);
+        pyramid->levels[level - 1] = NULL;
+      }
+      int gray = dst->nChannels == GRAY;
+      char filename[FILENAME_MAX];
+      snprintf(filename, sizeof(filename), "%s_level%d.%s",
+               pyramid->basename, level, gray ? "pgm" : "ppm");
+      image_error_t res = image_write(filename, dst,
+                                      gray ? PGM_FORMAT : PPM_FORMAT);
+      if (res != IMG_OK)
+      {
+        pyramid->result = res;
+      }
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Writes levels 1 to "levels" of an image pyramid of image to
+ * <basename>_level<i>.pgm (.ppm for colour images), where level i is
+ * downsampled by 2^i in each direction with a box filter. Each level is built
+ * from the one before it by "threads" threads and streamed to disk as soon as
+ * it is complete, so at most two levels besides image are held in memory at
+ * once. image must be row-major. Returns IMG_OK on success, or an appropriate
+ * error code on failure.
+ */
+image_error_t image_write_pyramid(const char *basename, image_t *image,
+                                  int levels, int threads)
+{
+  assert(image->layout == IMAGE_ROW_MAJOR);
+
+  pyramid_t pyramid;
+  pyramid.basename = basename;
+  pyramid.nLevels = levels + 1;
+  pyramid.nThreads = threads > 0 ? threads : 1;
+  pyramid.result = IMG_OK;
+  pyramid.levels = calloc(pyramid.nLevels, sizeof(image_t *));
+  if (pyramid.levels == NULL)
+  {
+    return IMG_INSUFFICIENT_MEMORY;
+  }
+
+  pyramid.levels[0] = image;
+  if (pyramid.nLevels > 1)
+  {
+    pyramid_allocate(&pyramid, 1);
+  }
+
+  pyramid_worker_t *workers = malloc(pyramid.nThreads
+                                     * sizeof(pyramid_worker_t));
+  pyramid.workers = workers;
+  if (workers == NULL)
+  {
+    pyramid.result = IMG_INSUFFICIENT_MEMORY;
+  }
+  else
+  {
+    pthread_mutex_init(&pyramid.lock, NULL);
+    pthread_cond_init(&pyramid.ready, NULL);
+    pyramid.started = 0;
+    int running = 1;
+    for (int i = 0; i < pyramid.nThreads; i++)
+    {
+      workers[i].pyramid = &pyramid;
+      workers[i].index = i;
+      workers[i].threaded = i > 0 && pthread_create(&workers[i].thread, NULL,
+                                                    pyramid_work,
+                                                    &workers[i]) == 0;
+      running += workers[i].threaded;
+    }
+    pthread_barrier_init(&pyramid.barrier, NULL, running);
+    pthread_mutex_lock(&pyramid.lock);
+    pyramid.started = 1;
+    pthread_cond_broadcast(&pyramid.ready);
+    pthread_mutex_unlock(&pyramid.lock);
+
+    pyramid_work(&workers[0]);
+    for (int i = 1; i < pyramid.nThreads; i++)
+    {
+      if (workers[i].threaded)
+      {
+        pthread_join(workers[i].thread, NULL);
+      }
+    }
+    pthread_barrier_destroy(&pyramid.barrier);
+    pthread_cond_destroy(&pyramid.ready);
+    pthread_mutex_destroy(&pyramid.lock);
+  }
+  free(workers);
+
+  for (int level = 1; level < pyramid.nLevels; level++)
+  {
+    image_free(pyramid.levels[level]);
+  }
+  free(pyramid.levels);
+  return pyramid.result;
+}
+
+//////////////////////////////////////////////////////////////
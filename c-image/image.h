@@ -0,0 +1,205 @@
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//////////////////////////////////////////////////////////////
+//DO NOT MODIFY ANYTHING FROM THIS FILE///////////////////////
+//////////////////////////////////////////////////////////////
+
+/*
+ * The different type of image formats that loader accept
+ */
+typedef enum {PBM_FORMAT, PPM_FORMAT,PGM_FORMAT} imageformat;
+
+/*
+ * The maximum intensity of an RGB and GRAY value.
+ */
+enum {DEPTH = 255};
+
+/*
+ * number of channels in image
+ */
+enum {GRAY = 1, RGB = 3};
+
+/*
+ * The buffer size to be used by the PPM loader.
+ */
+
+enum {BUFFER_SIZE = 16};
+
+/*
+ * The number of bytes image_read_mapped() reads to parse a header.
+ */
+enum {MAPPED_HEADER_SIZE = 1024};
+
+/*
+ * The stdio buffer size used by image streams.
+ */
+enum {STREAM_BUFFER_SIZE = 1 << 20};
+
+/*
+ * How an image's pixels are arranged in memory. IMAGE_TILED stores each
+ * TILE_SIZE x TILE_SIZE block of pixels contiguously, one cache line per tile
+ * for gray images, with the tiles in row-major order and the image padded to
+ * whole tiles. Pixels that are close in 2D are then close in memory whichever
+ * direction they are walked in. Files are always row-major.
+ */
+typedef enum {IMAGE_ROW_MAJOR, IMAGE_TILED} image_layout_t;
+enum {TILE_SHIFT = 3, TILE_SIZE = 1 << TILE_SHIFT};
+
+/*
+ * An image. widthStep is the size of a row in bytes; it is also the distance
+ * between rows for row-major images.
+ */
+typedef struct {
+  int width, height;
+  int nChannels;
+  int widthStep;
+  int depth;
+  uint8_t *pixelsData;
+  void *mapping;       // the file mapping pixelsData points into, or NULL
+  size_t mappingSize;
+  image_layout_t layout;
+} image_t;
+
+/*
+ * Returns the offset in pixelsData of the first channel of pixel (x,y) of
+ * image, whatever its layout.
+ */
+static inline size_t image_offset(const image_t *image, int x, int y)
+{
+  if (image->layout == IMAGE_TILED)
+  {
+    size_t tiles_per_row = (image->width + TILE_SIZE - 1) >> TILE_SHIFT;
+    size_t tile = (y >> TILE_SHIFT) * tiles_per_row + (x >> TILE_SHIFT);
+    size_t within = (y & (TILE_SIZE - 1)) * TILE_SIZE + (x & (TILE_SIZE - 1));
+    return (tile * TILE_SIZE * TILE_SIZE + within) * image->nChannels;
+  }
+  return (size_t) y * image->widthStep + (size_t) x * image->nChannels;
+}
+
+/*
+ * A rectangle of an image's pixels, described without copying them. Pixel
+ * (x, y) of the view starts at pixels + y * stride + x * nChannels. Views
+ * stay valid until the image they look into is freed.
+ */
+typedef struct {
+  uint8_t *pixels;
+  int width, height;
+  int nChannels;
+  ptrdiff_t stride;
+} image_view_t;
+
+/*
+ * An image being read or written a band of rows at a time. row is the number
+ * of rows read or written so far; buffer holds bandRows rows of widthStep
+ * bytes.
+ */
+typedef struct {
+  FILE *file;
+  int writable;
+  int width, height;
+  int nChannels;
+  int widthStep;
+  int depth;
+  int row;
+  int bandRows;
+  uint8_t *buffer;
+} image_stream_t;
+
+/*
+ * A maximal run of length pixels of equal first-channel value, starting at
+ * column start of a row.
+ */
+typedef struct {
+  int start;
+  int length;
+  uint8_t value;
+} image_run_t;
+
+/*
+ * The first channel of rows y0 to y0 + height - 1 of an image, stored as runs.
+ * The runs of row y0 + i, left to right, are the count[i] runs from
+ * runs[first[i]]. A row equal to the row above it in the band shares its
+ * runs: first[i] == first[i - 1]. The arrays are reused by later reads into
+ * the same image_runs_t.
+ */
+typedef struct {
+  int width;
+  int y0, height;
+  image_run_t *runs;
+  size_t nRuns, runCapacity;
+  size_t *first;
+  int *count;
+  int rowCapacity;
+  uint8_t *buffer;
+  size_t bufferSize;
+} image_runs_t;
+
+/*
+ * Image operation error codes.
+ */
+typedef enum{
+  IMG_OK,
+  IMG_OPEN_FAILURE,
+  IMG_MISSING_FORMAT,
+  IMG_INVALID_FORMAT,
+  IMG_INSUFFICIENT_MEMORY,
+  IMG_INVALID_SIZE,
+  IMG_INVALID_DEPTH,
+  IMG_READ_FAILURE,
+  IMG_WRITE_FAILURE
+} image_error_t;
+
+/*
+ * API prototypes.
+ */
+
+void image_print_error(image_error_t error_code);
+void image_free(image_t *image);
+image_error_t image_read(const char *filename, image_t **image_ptr);
+image_error_t image_read_mapped(const char *filename, image_t **image_ptr);
+image_error_t image_stream_open(const char *filename, int band_rows,
+                                image_stream_t **stream_ptr);
+image_error_t image_stream_read(image_stream_t *stream, int *count);
+image_error_t image_stream_create(const char *filename, int width, int height,
+                                  int nChannels, int band_rows,
+                                  image_stream_t **stream_ptr);
+image_error_t image_stream_write(image_stream_t *stream, const uint8_t *rows,
+                                 int count);
+image_error_t image_stream_close(image_stream_t *stream);
+image_error_t image_write(const char *filename, image_t *image,
+                          imageformat format);
+image_error_t image_write_rle(const char *filename, image_t *image);
+image_error_t init_image(image_t**, int, int, int, int);
+void set_pixel(image_t *image, int x, int y, uint8_t colour);
+uint8_t get_pixel(image_t *image, int x, int y);
+uint8_t *image_row(image_t *image, int y);
+image_error_t image_set_layout(image_t *image, image_layout_t layout);
+void image_fill_span(image_t *image, int x, int y, int length, uint8_t colour);
+void image_fill_rect(image_t *image, int x, int y, int width, int height,
+                     uint8_t colour);
+int image_row_equals(image_t *image, int x, int y, int length, uint8_t colour);
+image_view_t image_view(image_t *image);
+image_view_t image_view_crop(const image_view_t *view, int x, int y,
+                             int width, int height);
+uint8_t *image_view_row(const image_view_t *view, int y);
+uint8_t image_view_get_pixel(const image_view_t *view, int x, int y);
+void image_view_set_pixel(const image_view_t *view, int x, int y,
+                          uint8_t colour);
+void image_view_fill(const image_view_t *view, uint8_t colour);
+void image_runs_init(image_runs_t *runs);
+image_error_t image_runs_read(image_runs_t *runs, image_t *image, int y0,
+                              int height);
+image_error_t image_runs_read_stream(image_runs_t *runs,
+                                     image_stream_t *stream, int *count);
+void image_runs_free(image_runs_t *runs);
+image_error_t image_write_pyramid(const char *basename, image_t *image,
+                                  int levels, int threads);
+
+
+
+#endif /* IMAGE_H_ */
@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "kernels.h"
+
+/* Every kernel processes PIXELS pixels per call, as a FILL_WIDTH-wide
+ * rectangle for kernel_fill(); the buffers fit in the L2 cache of most
+ * processors. Each kernel runs for at least MIN_SECONDS per instruction set.
+ */
+enum {PIXELS = 1 << 18, FILL_WIDTH = 1024};
+static const double MIN_SECONDS = 0.2;
+
+static uint8_t *gray, *gray_copy, *rgb;
+static uint32_t histogram[256];
+
+/* Returns a monotonic time in seconds. */
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Each benchmark runs its kernel once and returns a checksum of the result,
+ * which must be the same for every instruction set.
+ */
+typedef unsigned long (*bench_t)(void);
+
+static unsigned long bench_fill(void)
+{
+  kernel_fill(gray, FILL_WIDTH, FILL_WIDTH - 3, PIXELS / FILL_WIDTH, 0x5a);
+  return gray[PIXELS - 4] + gray[PIXELS - 1];
+}
+
+static unsigned long bench_find_difference(void)
+{
+  return kernel_find_difference(gray_copy, PIXELS, 7);
+}
+
+static unsigned long bench_compare(void)
+{
+  return kernel_compare(gray, gray_copy, PIXELS);
+}
+
+/* Returns a checksum of histogram. */
+static unsigned long histogram_sum(void)
+{
+  unsigned long sum = 0;
+  for (int v = 0; v < 256; v++)
+  {
+    sum = sum * 31 + histogram[v];
+  }
+  return sum;
+}
+
+static unsigned long bench_histogram(void)
+{
+  memset(histogram, 0, sizeof(histogram));
+  kernel_histogram(rgb, 3 * PIXELS, histogram);
+  return histogram_sum();
+}
+
+/* As bench_histogram(), on uniform pixels as in the images regions are found
+ * in.
+ */
+static unsigned long bench_histogram_uniform(void)
+{
+  memset(histogram, 0, sizeof(histogram));
+  kernel_histogram(gray, PIXELS, histogram);
+  return histogram_sum();
+}
+
+static unsigned long bench_downsample(void)
+{
+  kernel_downsample(rgb + 3 * PIXELS, gray, rgb, PIXELS / 2);
+  unsigned long sum = 0;
+  for (int i = 0; i < PIXELS / 2; i += 97)
+  {
+    sum = sum * 31 + rgb[3 * PIXELS + i];
+  }
+  return sum;
+}
+
+static unsigned long bench_gray_to_rgb(void)
+{
+  kernel_gray_to_rgb(rgb + 3 * PIXELS, gray_copy, PIXELS);
+  return rgb[6 * PIXELS - 1] + rgb[3 * PIXELS + 5];
+}
+
+static unsigned long bench_rgb_to_gray(void)
+{
+  kernel_rgb_to_gray(gray, rgb, PIXELS);
+  unsigned long sum = 0;
+  for (int i = 0; i < PIXELS; i += 97)
+  {
+    sum = sum * 31 + gray[i];
+  }
+  return sum;
+}
+
+static const struct {
+  const char *name;
+  bench_t run;
+  double bytes;   // bytes read and written per call
+} benches[] = {
+  {"fill", bench_fill, PIXELS},
+  {"find_difference", bench_find_difference, PIXELS},
+  {"compare", bench_compare, 2.0 * PIXELS},
+  {"histogram", bench_histogram, 3.0 * PIXELS},
+  {"histogram_flat", bench_histogram_uniform, PIXELS},
+  {"downsample", bench_downsample, 2.5 * PIXELS},
+  {"gray_to_rgb", bench_gray_to_rgb, 4.0 * PIXELS},
+  {"rgb_to_gray", bench_rgb_to_gray, 4.0 * PIXELS},
+};
+
+/* Fills the buffers with data that keeps every kernel busy to the end:
+ * gray_copy is 7 except for its last byte and gray differs from it only
+ * there, so the searches scan the whole buffer.
+ */
+static void reset_buffers(void)
+{
+  memset(gray_copy, 7, PIXELS);
+  gray_copy[PIXELS - 1] = 8;
+  memcpy(gray, gray_copy, PIXELS);
+  gray[PIXELS - 1] = 9;
+  srand(1);
+  for (int i = 0; i < 3 * PIXELS; i++)
+  {
+    rgb[i] = rand() & 0xff;
+  }
+}
+
+/* Times every kernel on every instruction set the processor supports and
+ * checks that each one agrees with the scalar version.
+ */
+int main(void)
+{
+  gray = malloc(PIXELS);
+  gray_copy = malloc(PIXELS);
+  rgb = malloc(6 * PIXELS);
+  if (gray == NULL || gray_copy == NULL || rgb == NULL)
+  {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  kernel_isa_t best = kernel_select(KERNEL_AVX2);
+  int failures = 0;
+  printf("%-16s %-7s %10s %8s  %s\n", "kernel", "isa", "GB/s", "speedup",
+         "check");
+  for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+  {
+    unsigned long expected = 0;
+    double scalar_rate = 0.0;
+    for (kernel_isa_t isa = KERNEL_SCALAR; isa <= best; isa++)
+    {
+      kernel_select(isa);
+      reset_buffers();
+      unsigned long result = benches[b].run();
+      reset_buffers();
+      long calls = 0;
+      double start = now(), elapsed;
+      do
+      {
+        benches[b].run();
+        calls++;
+        elapsed = now() - start;
+      } while (elapsed < MIN_SECONDS);
+
+      double rate = benches[b].bytes * calls / elapsed / 1e9;
+      if (isa == KERNEL_SCALAR)
+      {
+        expected = result;
+        scalar_rate = rate;
+      }
+      int ok = result == expected;
+      failures += !ok;
+      printf("%-16s %-7s %10.2f %7.2fx  %s\n", benches[b].name,
+             kernel_isa_name(isa), rate, rate / scalar_rate,
+             ok ? "ok" : "MISMATCH");
+    }
+  }
+
+  free(gray);
+  free(gray_copy);
+  free(rgb);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,607 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Luma weights for RGB to gray conversion, in 8.8 fixed point (ITU-R BT.601).
+ */
+enum {LUMA_R = 77, LUMA_G = 150, LUMA_B = 29};
+
+/*
+ * The versions of the kernels in use.
+ */
+typedef struct {
+  kernel_isa_t isa;
+  size_t (*find_difference)(const uint8_t *, size_t, uint8_t);
+  size_t (*compare)(const uint8_t *, const uint8_t *, size_t);
+  void (*gray_to_rgb)(uint8_t *, const uint8_t *, size_t);
+  void (*rgb_to_gray)(uint8_t *, const uint8_t *, size_t);
+  void (*histogram)(const uint8_t *, size_t, uint32_t *);
+  void (*downsample)(uint8_t *, const uint8_t *, const uint8_t *, size_t);
+} kernel_table_t;
+
+static kernel_table_t kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar kernels.
+///////////////////////////////////////////////////////////////////////////////
+
+static size_t find_difference_scalar(const uint8_t *src, size_t length,
+                                     uint8_t value)
+{
+  size_t i = 0;
+  while (i < length && src[i] == value)
+  {
+    i++;
+  }
+  return i;
+}
+
+static size_t compare_scalar(const uint8_t *a, const uint8_t *b, size_t length)
+{
+  size_t i = 0;
+  while (i < length && a[i] == b[i])
+  {
+    i++;
+  }
+  return i;
+}
+
+static void gray_to_rgb_scalar(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+  for (size_t i = 0; i < pixels; i++, dst += 3)
+  {
+    dst[0] = dst[1] = dst[2] = src[i];
+  }
+}
+
+static void rgb_to_gray_scalar(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+  for (size_t i = 0; i < pixels; i++, src += 3)
+  {
+    dst[i] = (LUMA_R * src[0] + LUMA_G * src[1] + LUMA_B * src[2] + 128) >> 8;
+  }
+}
+
+/*
+ * Counts the length bytes at src into the four tables of counts. Counting
+ * into separate tables keeps runs of equal bytes from serialising on one
+ * counter.
+ */
+static void count_bytes(uint32_t counts[4][256], const uint8_t *src,
+                        size_t length)
+{
+  size_t i = 0;
+  for (; i + 4 <= length; i += 4)
+  {
+    counts[0][src[i]]++;
+    counts[1][src[i + 1]]++;
+    counts[2][src[i + 2]]++;
+    counts[3][src[i + 3]]++;
+  }
+  for (; i < length; i++)
+  {
+    counts[0][src[i]]++;
+  }
+}
+
+/*
+ * Adds the four tables of counts to histogram.
+ */
+static void add_counts(uint32_t *histogram, uint32_t counts[4][256])
+{
+  for (int v = 0; v < 256; v++)
+  {
+    histogram[v] += counts[0][v] + counts[1][v] + counts[2][v] + counts[3][v];
+  }
+}
+
+static void histogram_scalar(const uint8_t *src, size_t length,
+                             uint32_t *histogram)
+{
+  uint32_t counts[4][256] = {{0}};
+  count_bytes(counts, src, length);
+  add_counts(histogram, counts);
+}
+
+static void downsample_scalar(uint8_t *dst, const uint8_t *r0,
+                              const uint8_t *r1, size_t pixels)
+{
+  for (size_t x = 0; x < pixels; x++)
+  {
+    dst[x] = (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2;
+  }
+}
+
+#ifdef KERNEL_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE2 kernels: 16 bytes at a time, unaligned.
+///////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("sse2")))
+static size_t find_difference_sse2(const uint8_t *src, size_t length,
+                                   uint8_t value)
+{
+  __m128i v = _mm_set1_epi8((char) value);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (src + i)),
+                                v);
+    unsigned int mask = ~_mm_movemask_epi8(eq) & 0xffff;
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + find_difference_scalar(src + i, length - i, value);
+}
+
+__attribute__((target("sse2")))
+static size_t compare_sse2(const uint8_t *a, const uint8_t *b, size_t length)
+{
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i)),
+                                _mm_loadu_si128((const __m128i *) (b + i)));
+    unsigned int mask = ~_mm_movemask_epi8(eq) & 0xffff;
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + compare_scalar(a + i, b + i, length - i);
+}
+
+/*
+ * Scattered increments do not vectorise, but images are mostly runs of equal
+ * bytes: a block of 16 bytes that all equal its first is counted at once.
+ */
+__attribute__((target("sse2")))
+static void histogram_sse2(const uint8_t *src, size_t length,
+                           uint32_t *histogram)
+{
+  uint32_t counts[4][256] = {{0}};
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16)
+  {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (src + i)),
+                                _mm_set1_epi8((char) src[i]));
+    if (_mm_movemask_epi8(eq) == 0xffff)
+    {
+      counts[0][src[i]] += 16;
+    }
+    else
+    {
+      count_bytes(counts, src + i, 16);
+    }
+  }
+  count_bytes(counts, src + i, length - i);
+  add_counts(histogram, counts);
+}
+
+/*
+ * Sums each pair of adjacent bytes of a and of b, as 16-bit lanes.
+ */
+__attribute__((target("sse2")))
+static __m128i pair_sums_sse2(__m128i a, __m128i b)
+{
+  const __m128i low = _mm_set1_epi16(0xff);
+  return _mm_add_epi16(
+      _mm_add_epi16(_mm_and_si128(a, low), _mm_srli_epi16(a, 8)),
+      _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8)));
+}
+
+__attribute__((target("sse2")))
+static void downsample_sse2(uint8_t *dst, const uint8_t *r0,
+                            const uint8_t *r1, size_t pixels)
+{
+  const __m128i two = _mm_set1_epi16(2);
+  size_t x = 0;
+  for (; x + 16 <= pixels; x += 16)
+  {
+    const __m128i *a = (const __m128i *) (r0 + 2 * x);
+    const __m128i *b = (const __m128i *) (r1 + 2 * x);
+    __m128i lo = pair_sums_sse2(_mm_loadu_si128(a), _mm_loadu_si128(b));
+    __m128i hi = pair_sums_sse2(_mm_loadu_si128(a + 1),
+                                _mm_loadu_si128(b + 1));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+    _mm_storeu_si128((__m128i *) (dst + x), _mm_packus_epi16(lo, hi));
+  }
+  downsample_scalar(dst + x, r0 + 2 * x, r1 + 2 * x, pixels - x);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels: 32 bytes at a time, unaligned. The conversions interleave 16
+// pixels at a time with byte shuffles, which every AVX2 processor has.
+///////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2")))
+static size_t find_difference_avx2(const uint8_t *src, size_t length,
+                                   uint8_t value)
+{
+  __m256i v = _mm256_set1_epi8((char) value);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32)
+  {
+    __m256i eq = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i *) (src + i)), v);
+    unsigned int mask = ~(unsigned int) _mm256_movemask_epi8(eq);
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + find_difference_sse2(src + i, length - i, value);
+}
+
+__attribute__((target("avx2")))
+static size_t compare_avx2(const uint8_t *a, const uint8_t *b, size_t length)
+{
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32)
+  {
+    __m256i eq = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i *) (a + i)),
+        _mm256_loadu_si256((const __m256i *) (b + i)));
+    unsigned int mask = ~(unsigned int) _mm256_movemask_epi8(eq);
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + compare_sse2(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void gray_to_rgb_avx2(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+  // Output byte k of each 48-byte group comes from gray pixel k / 3.
+  const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2,
+                                   2, 3, 3, 3, 4, 4, 4, 5);
+  const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7,
+                                   8, 8, 8, 9, 9, 9, 10, 10);
+  const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13,
+                                   13, 13, 14, 14, 14, 15, 15, 15);
+  size_t i = 0;
+  for (; i + 16 <= pixels; i += 16, dst += 48)
+  {
+    __m128i g = _mm_loadu_si128((const __m128i *) (src + i));
+    _mm_storeu_si128((__m128i *) dst, _mm_shuffle_epi8(g, m0));
+    _mm_storeu_si128((__m128i *) (dst + 16), _mm_shuffle_epi8(g, m1));
+    _mm_storeu_si128((__m128i *) (dst + 32), _mm_shuffle_epi8(g, m2));
+  }
+  gray_to_rgb_scalar(dst, src + i, pixels - i);
+}
+
+/*
+ * Shuffle masks gathering channel c of 16 interleaved RGB pixels: byte i of
+ * rgb_masks[c][v] selects byte 3i + c of the 48-byte group if it lies in the
+ * v-th 16 bytes, and is Z (zero the lane) otherwise.
+ */
+enum {Z = 0x80};
+static const uint8_t rgb_masks[3][3][16] = {
+  {
+    {0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+    {Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14, Z, Z, Z, Z, Z},
+    {Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 1, 4, 7, 10, 13},
+  },
+  {
+    {1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+    {Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z},
+    {Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14},
+  },
+  {
+    {2, 5, 8, 11, 14, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+    {Z, Z, Z, Z, Z, 1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z},
+    {Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15},
+  },
+};
+
+/*
+ * Gathers channel c of 16 interleaved RGB pixels from the 48 bytes in s0, s1
+ * and s2, zero-extended to 16 bits: the low 8 pixels in lo, the rest in hi.
+ */
+__attribute__((target("avx2")))
+static void gather_channel(__m128i s0, __m128i s1, __m128i s2, int c,
+                           __m128i *lo, __m128i *hi)
+{
+  const __m128i *masks = (const __m128i *) rgb_masks[c];
+  __m128i channel = _mm_or_si128(
+      _mm_or_si128(_mm_shuffle_epi8(s0, _mm_loadu_si128(masks)),
+                   _mm_shuffle_epi8(s1, _mm_loadu_si128(masks + 1))),
+      _mm_shuffle_epi8(s2, _mm_loadu_si128(masks + 2)));
+  *lo = _mm_unpacklo_epi8(channel, _mm_setzero_si128());
+  *hi = _mm_unpackhi_epi8(channel, _mm_setzero_si128());
+}
+
+__attribute__((target("avx2")))
+static void rgb_to_gray_avx2(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+  const __m128i wr = _mm_set1_epi16(LUMA_R);
+  const __m128i wg = _mm_set1_epi16(LUMA_G);
+  const __m128i wb = _mm_set1_epi16(LUMA_B);
+  const __m128i half = _mm_set1_epi16(128);
+  size_t i = 0;
+  for (; i + 16 <= pixels; i += 16, src += 48)
+  {
+    __m128i s0 = _mm_loadu_si128((const __m128i *) src);
+    __m128i s1 = _mm_loadu_si128((const __m128i *) (src + 16));
+    __m128i s2 = _mm_loadu_si128((const __m128i *) (src + 32));
+    __m128i rl, rh, gl, gh, bl, bh;
+    gather_channel(s0, s1, s2, 0, &rl, &rh);
+    gather_channel(s0, s1, s2, 1, &gl, &gh);
+    gather_channel(s0, s1, s2, 2, &bl, &bh);
+    // The weighted sum is at most 255 * 256 + 128, so 16 bits suffice.
+    __m128i lo = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(rl, wr), _mm_mullo_epi16(gl, wg)),
+        _mm_add_epi16(_mm_mullo_epi16(bl, wb), half));
+    __m128i hi = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(rh, wr), _mm_mullo_epi16(gh, wg)),
+        _mm_add_epi16(_mm_mullo_epi16(bh, wb), half));
+    _mm_storeu_si128((__m128i *) (dst + i),
+                     _mm_packus_epi16(_mm_srli_epi16(lo, 8),
+                                      _mm_srli_epi16(hi, 8)));
+  }
+  rgb_to_gray_scalar(dst + i, src, pixels - i);
+}
+
+__attribute__((target("avx2")))
+static void histogram_avx2(const uint8_t *src, size_t length,
+                           uint32_t *histogram)
+{
+  uint32_t counts[4][256] = {{0}};
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32)
+  {
+    __m256i eq = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i *) (src + i)),
+        _mm256_set1_epi8((char) src[i]));
+    if (_mm256_movemask_epi8(eq) == -1)
+    {
+      counts[0][src[i]] += 32;
+    }
+    else
+    {
+      count_bytes(counts, src + i, 32);
+    }
+  }
+  count_bytes(counts, src + i, length - i);
+  add_counts(histogram, counts);
+}
+
+/*
+ * Sums each pair of adjacent bytes of a and of b, as 16-bit lanes.
+ */
+__attribute__((target("avx2")))
+static __m256i pair_sums_avx2(__m256i a, __m256i b)
+{
+  const __m256i low = _mm256_set1_epi16(0xff);
+  return _mm256_add_epi16(
+      _mm256_add_epi16(_mm256_and_si256(a, low), _mm256_srli_epi16(a, 8)),
+      _mm256_add_epi16(_mm256_and_si256(b, low), _mm256_srli_epi16(b, 8)));
+}
+
+__attribute__((target("avx2")))
+static void downsample_avx2(uint8_t *dst, const uint8_t *r0,
+                            const uint8_t *r1, size_t pixels)
+{
+  const __m256i two = _mm256_set1_epi16(2);
+  size_t x = 0;
+  for (; x + 32 <= pixels; x += 32)
+  {
+    const __m256i *a = (const __m256i *) (r0 + 2 * x);
+    const __m256i *b = (const __m256i *) (r1 + 2 * x);
+    __m256i lo = pair_sums_avx2(_mm256_loadu_si256(a), _mm256_loadu_si256(b));
+    __m256i hi = pair_sums_avx2(_mm256_loadu_si256(a + 1),
+                                _mm256_loadu_si256(b + 1));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+    // The pack works within 128-bit lanes; restore the order of the quarters.
+    __m256i packed = _mm256_packus_epi16(lo, hi);
+    _mm256_storeu_si256((__m256i *) (dst + x),
+                        _mm256_permute4x64_epi64(packed, 0xd8));
+  }
+  downsample_sse2(dst + x, r0 + 2 * x, r1 + 2 * x, pixels - x);
+}
+
+#endif /* KERNEL_X86 */
+
+///////////////////////////////////////////////////////////////////////////////
+// Dispatch.
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Returns the most capable instruction set the processor supports.
+ */
+static kernel_isa_t supported_isa(void)
+{
+#ifdef KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return KERNEL_AVX2;
+  }
+  if (__builtin_cpu_supports("sse2"))
+  {
+    return KERNEL_SSE2;
+  }
+#endif
+  return KERNEL_SCALAR;
+}
+
+/*
+ * Points the kernel table at the versions for isa. The SSE2 level has no
+ * conversion kernels of its own, since interleaving needs byte shuffles.
+ * kernel_fill() is not dispatched.
+ */
+static void use_isa(kernel_isa_t isa)
+{
+  kernels.isa = isa;
+  kernels.find_difference = find_difference_scalar;
+  kernels.compare = compare_scalar;
+  kernels.gray_to_rgb = gray_to_rgb_scalar;
+  kernels.rgb_to_gray = rgb_to_gray_scalar;
+  kernels.histogram = histogram_scalar;
+  kernels.downsample = downsample_scalar;
+#ifdef KERNEL_X86
+  if (isa >= KERNEL_SSE2)
+  {
+    kernels.find_difference = find_difference_sse2;
+    kernels.compare = compare_sse2;
+    kernels.histogram = histogram_sse2;
+    kernels.downsample = downsample_sse2;
+  }
+  if (isa >= KERNEL_AVX2)
+  {
+    kernels.find_difference = find_difference_avx2;
+    kernels.compare = compare_avx2;
+    kernels.gray_to_rgb = gray_to_rgb_avx2;
+    kernels.rgb_to_gray = rgb_to_gray_avx2;
+    kernels.histogram = histogram_avx2;
+    kernels.downsample = downsample_avx2;
+  }
+#endif
+}
+
+/*
+ * Selects the most capable supported instruction set, capped by the
+ * IMAGE_KERNELS environment variable ("scalar", "sse2" or "avx2") if set.
+ */
+static void kernels_init(void)
+{
+  kernel_isa_t isa = supported_isa();
+  const char *cap = getenv("IMAGE_KERNELS");
+  for (kernel_isa_t level = KERNEL_SCALAR; cap != NULL && level < isa; level++)
+  {
+    if (strcmp(cap, kernel_isa_name(level)) == 0)
+    {
+      isa = level;
+    }
+  }
+  use_isa(isa);
+}
+
+/*
+ * Returns the instruction set the kernels currently run on.
+ */
+kernel_isa_t kernel_isa(void)
+{
+  pthread_once(&kernels_once, kernels_init);
+  return kernels.isa;
+}
+
+/*
+ * Switches every kernel to isa, or to the most capable supported instruction
+ * set below it, and returns the one chosen. Not safe to call while other
+ * threads are running kernels; meant for benchmarks and tests.
+ */
+kernel_isa_t kernel_select(kernel_isa_t isa)
+{
+  pthread_once(&kernels_once, kernels_init);
+  kernel_isa_t supported = supported_isa();
+  use_isa(isa < supported ? isa : supported);
+  return kernels.isa;
+}
+
+/*
+ * Returns the lower-case name of isa.
+ */
+const char *kernel_isa_name(kernel_isa_t isa)
+{
+  switch (isa)
+  {
+    case KERNEL_SSE2: return "sse2";
+    case KERNEL_AVX2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+/*
+ * Writes "value" to width bytes of each of height rows, stride bytes apart,
+ * starting at dst. The C library's memset() is already vectorised for the
+ * processor it runs on, and explicit SSE2/AVX2 stores measured no faster, so
+ * every instruction set uses it.
+ */
+void kernel_fill(uint8_t *dst, ptrdiff_t stride, size_t width, size_t height,
+                 uint8_t value)
+{
+  for (size_t j = 0; j < height; j++, dst += stride)
+  {
+    memset(dst, value, width);
+  }
+}
+
+/*
+ * Returns the index of the first of the length bytes at src that is not
+ * "value", or length if they all are.
+ */
+size_t kernel_find_difference(const uint8_t *src, size_t length, uint8_t value)
+{
+  pthread_once(&kernels_once, kernels_init);
+  return kernels.find_difference(src, length, value);
+}
+
+/*
+ * Returns the index of the first byte at which the length bytes at a and b
+ * differ, or length if they are equal.
+ */
+size_t kernel_compare(const uint8_t *a, const uint8_t *b, size_t length)
+{
+  pthread_once(&kernels_once, kernels_init);
+  return kernels.compare(a, b, length);
+}
+
+/*
+ * Adds the number of occurrences of each value among the length bytes at src
+ * to histogram.
+ */
+void kernel_histogram(const uint8_t *src, size_t length,
+                      uint32_t histogram[256])
+{
+  pthread_once(&kernels_once, kernels_init);
+  kernels.histogram(src, length, histogram);
+}
+
+/*
+ * Writes to each of the pixels bytes at dst the average, rounded to nearest,
+ * of the 2x2 block of bytes below it in rows r0 and r1, which hold 2 * pixels
+ * bytes each.
+ */
+void kernel_downsample(uint8_t *dst, const uint8_t *r0, const uint8_t *r1,
+                       size_t pixels)
+{
+  pthread_once(&kernels_once, kernels_init);
+  kernels.downsample(dst, r0, r1, pixels);
+}
+
+/*
+ * Expands pixels gray bytes at src into RGB triples at dst.
+ */
+void kernel_gray_to_rgb(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+  pthread_once(&kernels_once, kernels_init);
+  kernels.gray_to_rgb(dst, src, pixels);
+}
+
+/*
+ * Converts pixels RGB triples at src to gray bytes at dst using the BT.601
+ * luma weights, rounded to nearest.
+ */
+void kernel_rgb_to_gray(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+  pthread_once(&kernels_once, kernels_init);
+  kernels.rgb_to_gray(dst, src, pixels);
+}
@@ -0,0 +1,33 @@
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The instruction sets a kernel can be dispatched to, in increasing order.
+ * Every kernel has a scalar version; the others are used when the processor
+ * supports them.
+ */
+typedef enum {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2} kernel_isa_t;
+
+/*
+ * Kernel API prototypes.
+ */
+
+kernel_isa_t kernel_isa(void);
+kernel_isa_t kernel_select(kernel_isa_t isa);
+const char *kernel_isa_name(kernel_isa_t isa);
+void kernel_fill(uint8_t *dst, ptrdiff_t stride, size_t width, size_t height,
+                 uint8_t value);
+size_t kernel_find_difference(const uint8_t *src, size_t length,
+                              uint8_t value);
+size_t kernel_compare(const uint8_t *a, const uint8_t *b, size_t length);
+void kernel_histogram(const uint8_t *src, size_t length,
+                      uint32_t histogram[256]);
+void kernel_downsample(uint8_t *dst, const uint8_t *r0, const uint8_t *r1,
+                       size_t pixels);
+void kernel_gray_to_rgb(uint8_t *dst, const uint8_t *src, size_t pixels);
+void kernel_rgb_to_gray(uint8_t *dst, const uint8_t *src, size_t pixels);
+
+#endif /* KERNELS_H_ */
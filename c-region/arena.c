@@ -0,0 +1,65 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+// Objects are aligned as strictly as the most demanding of these.
+typedef union arena_align
+{
+  void *pointer;
+  long integer;
+  double real;
+} arena_align_t;
+
+// The block header, rounded up so that storage after it is aligned.
+enum {HEADER_SIZE = (sizeof(arena_block_t) + sizeof(arena_align_t) - 1)
+                    / sizeof(arena_align_t) * sizeof(arena_align_t)};
+
+void region_arena_init(region_arena_t *arena)
+{
+  arena->blocks = NULL;
+  arena->allocations = 0;
+  arena->block_count = 0;
+}
+
+void *region_arena_allocate(region_arena_t *arena, size_t size)
+{
+  size = (size + sizeof(arena_align_t) - 1) / sizeof(arena_align_t)
+         * sizeof(arena_align_t);
+  arena_block_t *block = arena->blocks;
+  if (block == NULL || block->size - block->used < size)
+  {
+    size_t block_size = block != NULL ? 2 * block->size : ARENA_FIRST_BLOCK;
+    while (block_size < size)
+    {
+      block_size *= 2;
+    }
+    block = malloc(HEADER_SIZE + block_size);
+    if (block == NULL)
+    {
+      perror("region_arena_allocate");
+      exit(EXIT_FAILURE);
+    }
+    block->next = arena->blocks;
+    block->size = block_size;
+    block->used = 0;
+    arena->blocks = block;
+    arena->block_count++;
+  }
+
+  void *memory = (char *) block + HEADER_SIZE + block->used;
+  block->used += size;
+  arena->allocations++;
+  return memory;
+}
+
+void region_arena_release(region_arena_t *arena)
+{
+  arena_block_t *block = arena->blocks;
+  while (block != NULL)
+  {
+    arena_block_t *next = block->next;
+    free(block);
+    block = next;
+  }
+  region_arena_init(arena);
+}
@@ -0,0 +1,39 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+// Size of the first block of an arena; each later block is twice the size of
+// the one before.
+enum {ARENA_FIRST_BLOCK = 64 * 1024};
+
+// A block of arena memory, followed by its "size" bytes of storage.
+typedef struct arena_block
+{
+  struct arena_block *next;
+  size_t size;
+  size_t used;
+} arena_block_t;
+
+// Memory for many small objects that are all freed together, such as the
+// regions and list elements of a detection result. "allocations" counts the
+// objects allocated and "block_count" the calls to malloc() made for them.
+typedef struct region_arena
+{
+  arena_block_t *blocks;
+  size_t allocations;
+  size_t block_count;
+} region_arena_t;
+
+// Initialises an empty arena.
+void region_arena_init(region_arena_t *arena);
+
+// Allocates "size" bytes from "arena", suitably aligned for any object. You
+// may assume that the return value is non-NULL.
+void *region_arena_allocate(region_arena_t *arena, size_t size);
+
+// Frees all memory allocated from "arena", which is left empty, in one call
+// to free() per block.
+void region_arena_release(region_arena_t *arena);
+
+#endif
@@ -0,0 +1,327 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "image.h"
+#include "region.h"
+#include "region_file.h"
+#include "scanline.h"
+#include "list.h"
+#include "typedefs.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A growable array of file names.
+typedef struct file_list
+{
+  char **names;
+  int count;
+  int capacity;
+} file_list_t;
+
+// State shared by the loader and the workers. Files are claimed in order;
+// the loader stays up to BATCH_PREFETCH files ahead of the next claim.
+typedef struct batch
+{
+  const batch_options_t *options;
+  file_list_t files;
+  pthread_mutex_t lock;
+  pthread_cond_t claimed;
+  int next;         // next file to be claimed by a worker
+  int failures;
+} batch_t;
+
+// Appends a copy of "name" to "list". Returns 0 if memory ran out.
+static int file_list_add(file_list_t *list, const char *name)
+{
+  if (list->count == list->capacity)
+  {
+    int capacity = list->capacity > 0 ? 2 * list->capacity : 64;
+    char **names = realloc(list->names, capacity * sizeof(char *));
+    if (names == NULL)
+    {
+      return 0;
+    }
+    list->names = names;
+    list->capacity = capacity;
+  }
+  size_t length = strlen(name) + 1;
+  char *copy = malloc(length);
+  if (copy == NULL)
+  {
+    return 0;
+  }
+  memcpy(copy, name, length);
+  list->names[list->count++] = copy;
+  return 1;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+  return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+// Adds the regular files in directory "path" to "list" in name order.
+// Returns 0 on failure.
+static int add_directory(file_list_t *list, const char *path)
+{
+  DIR *dir = opendir(path);
+  if (dir == NULL)
+  {
+    perror(path);
+    return 0;
+  }
+  int first = list->count;
+  int ok = 1;
+  struct dirent *entry;
+  char name[4096];
+  while (ok && (entry = readdir(dir)) != NULL)
+  {
+    struct stat st;
+    snprintf(name, sizeof(name), "%s/%s", path, entry->d_name);
+    if (stat(name, &st) == 0 && S_ISREG(st.st_mode))
+    {
+      ok = file_list_add(list, name);
+    }
+  }
+  closedir(dir);
+  qsort(list->names + first, list->count - first, sizeof(char *),
+        compare_names);
+  return ok;
+}
+
+// Adds the paths listed one per line in file "path" to "list". Returns 0 on
+// failure.
+static int add_list_file(file_list_t *list, const char *path)
+{
+  FILE *in = fopen(path, "r");
+  if (in == NULL)
+  {
+    perror(path);
+    return 0;
+  }
+  int ok = 1;
+  char line[4096];
+  while (ok && fgets(line, sizeof(line), in) != NULL)
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] != '\0')
+    {
+      ok = file_list_add(list, line);
+    }
+  }
+  fclose(in);
+  return ok;
+}
+
+// Writes <output_dir>/<name><suffix> to "path", where <name> is the file name
+// of "input" without its directory or extension.
+static void output_path(char *path, size_t size, const char *output_dir,
+                        const char *input, const char *suffix)
+{
+  const char *name = strrchr(input, '/');
+  name = name != NULL ? name + 1 : input;
+  const char *dot = strrchr(name, '.');
+  int length = dot != NULL && dot != name ? (int) (dot - name)
+                                          : (int) strlen(name);
+  snprintf(path, size, "%s/%.*s%s", output_dir, length, name, suffix);
+}
+
+// Finds the regions of image file "input" and writes its outputs. Returns 1
+// on success; failures are reported on stderr.
+static int process_image(const batch_options_t *options, const char *input)
+{
+  image_t *img_in = NULL;
+  image_error_t img_err = image_read_mapped(input, &img_in);
+  if (img_err == IMG_OK)
+  {
+    img_err = image_set_layout(img_in, options->layout);
+  }
+  if (img_err)
+  {
+    fprintf(stderr, "%s: ", input);
+    image_print_error(img_err);
+    image_free(img_in);
+    return 0;
+  }
+
+  region_arena_t arena;
+  region_arena_init(&arena);
+  list_t regions;
+  list_init_arena(&regions, &arena);
+  scanline_find_regions(&regions, img_in);
+
+  char path[4096];
+  int ok;
+  if (options->binary_output)
+  {
+    output_path(path, sizeof(path), options->output_dir, input, ".rgn");
+    ok = region_file_write(path, &regions);
+  }
+  else
+  {
+    output_path(path, sizeof(path), options->output_dir, input, ".txt");
+    FILE *text_out = fopen(path, "w");
+    ok = text_out != NULL;
+    if (ok)
+    {
+      print_regions(text_out, &regions);
+      ok = fclose(text_out) == 0;
+    }
+    if (!ok)
+    {
+      perror(path);
+    }
+  }
+
+  image_t *img_out = NULL;
+  img_err = init_image(&img_out, img_in->width, img_in->height, GRAY, 255);
+  if (img_err == IMG_OK)
+  {
+    render_regions(img_out, &regions, region_colour);
+    output_path(path, sizeof(path), options->output_dir, input, ".pgm");
+    img_err = options->rle_output ? image_write_rle(path, img_out)
+                                  : image_write(path, img_out, PGM_FORMAT);
+  }
+  if (img_err)
+  {
+    fprintf(stderr, "%s: ", path);
+    image_print_error(img_err);
+    ok = 0;
+  }
+
+  list_destroy(&regions);
+  image_free(img_in);
+  image_free(img_out);
+  return ok;
+}
+
+// Loader thread: asks the kernel to start reading each file before a worker
+// claims it, so that reading overlaps with region detection.
+static void *batch_load(void *arg)
+{
+  batch_t *batch = arg;
+  for (int i = 0; i < batch->files.count; i++)
+  {
+    pthread_mutex_lock(&batch->lock);
+    while (i >= batch->next + BATCH_PREFETCH)
+    {
+      pthread_cond_wait(&batch->claimed, &batch->lock);
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    int fd = open(batch->files.names[i], O_RDONLY);
+    if (fd >= 0)
+    {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+      close(fd);
+    }
+  }
+  return NULL;
+}
+
+// Worker thread: claims files in order until none are left.
+static void *batch_work(void *arg)
+{
+  batch_t *batch = arg;
+  for (;;)
+  {
+    pthread_mutex_lock(&batch->lock);
+    int i = batch->next < batch->files.count ? batch->next++ : -1;
+    pthread_cond_signal(&batch->claimed);
+    pthread_mutex_unlock(&batch->lock);
+    if (i < 0)
+    {
+      return NULL;
+    }
+
+    if (!process_image(batch->options, batch->files.names[i]))
+    {
+      pthread_mutex_lock(&batch->lock);
+      batch->failures++;
+      pthread_mutex_unlock(&batch->lock);
+    }
+  }
+}
+
+int batch_run(const batch_options_t *options, char **inputs, int count)
+{
+  batch_t batch;
+  batch.options = options;
+  batch.files.names = NULL;
+  batch.files.count = 0;
+  batch.files.capacity = 0;
+  batch.next = 0;
+  batch.failures = 0;
+
+  int ok = 1;
+  for (int i = 0; ok && i < count; i++)
+  {
+    struct stat st;
+    if (inputs[i][0] == '@')
+    {
+      ok = add_list_file(&batch.files, inputs[i] + 1);
+    }
+    else if (stat(inputs[i], &st) == 0 && S_ISDIR(st.st_mode))
+    {
+      ok = add_directory(&batch.files, inputs[i]);
+    }
+    else
+    {
+      ok = file_list_add(&batch.files, inputs[i]);
+    }
+  }
+  if (ok && mkdir(options->output_dir, 0777) != 0 && errno != EEXIST)
+  {
+    perror(options->output_dir);
+    ok = 0;
+  }
+
+  int threads = options->threads > 0 ? options->threads : 1;
+  pthread_t loader;
+  pthread_t *workers = malloc(threads * sizeof(pthread_t));
+  if (ok && workers != NULL)
+  {
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.claimed, NULL);
+    int loading = pthread_create(&loader, NULL, batch_load, &batch) == 0;
+    int started = 0;
+    while (started < threads
+           && pthread_create(&workers[started], NULL, batch_work, &batch) == 0)
+    {
+      started++;
+    }
+    if (started == 0)
+    {
+      batch_work(&batch);
+    }
+    for (int i = 0; i < started; i++)
+    {
+      pthread_join(workers[i], NULL);
+    }
+    if (loading)
+    {
+      pthread_join(loader, NULL);
+    }
+    pthread_cond_destroy(&batch.claimed);
+    pthread_mutex_destroy(&batch.lock);
+  }
+  else if (ok)
+  {
+    ok = 0;
+  }
+
+  free(workers);
+  for (int i = 0; i < batch.files.count; i++)
+  {
+    free(batch.files.names[i]);
+  }
+  free(batch.files.names);
+  return ok ? batch.failures : -1;
+}
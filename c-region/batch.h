@@ -0,0 +1,33 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "image.h"
+
+// Number of files the loader asks the kernel to read ahead of the workers.
+enum {BATCH_PREFETCH = 8};
+
+// Settings for batch_run().
+// output_dir: directory that per-image outputs are written to.
+// threads: number of worker threads.
+// rle_output: write rendered images run-length encoded.
+// binary_output: write regions to binary region files instead of text.
+// layout: memory layout input images are scanned in.
+typedef struct batch_options
+{
+  const char *output_dir;
+  int threads;
+  int rle_output;
+  int binary_output;
+  image_layout_t layout;
+} batch_options_t;
+
+// Finds the regions of every image named by "inputs" on a pool of worker
+// threads. Each input is an image file, a directory whose files are all
+// images, or "@list" for a file listing one image path per line. The regions
+// of image <dir>/<name>.<ext> are written to <output_dir>/<name>.txt, or to
+// <output_dir>/<name>.rgn with binary_output, and the re-rendered image to
+// <output_dir>/<name>.pgm. Returns the number of images
+// that could not be processed, or -1 if the inputs could not be listed.
+int batch_run(const batch_options_t *options, char **inputs, int count);
+
+#endif
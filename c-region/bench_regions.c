@@ -0,0 +1,729 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "image.h"
+#include "region.h"
+#include "region_file.h"
+#include "scanline.h"
+#include "tree.h"
+#include "update.h"
+#include "list.h"
+#include "typedefs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Region detection benchmark. Runs each region detector on an image stored in
+// each memory layout and checks that they all find the same regions as
+// find_regions() on a row-major image. Then times building the region tree
+// and looking up the region at the corner of every region with it, and
+// compares the allocations made for results with and without an arena.
+// It then writes the regions as text, with fprintf() and with print_regions(),
+// and as a binary region file that is read back, and checks that streaming
+// the image from a file a band at a time finds the same regions. It renders
+// the regions with render_regions() and render_regions_spans() and checks
+// that both give the same image. Finally it edits the image one rectangle at
+// a time and checks that updating the regions after each change matches
+// finding them all again.
+//
+// Usage: bench_regions [input_image | width height]
+// Without an input image, a width x height image (default 4096 x 4096) of
+// randomly nested rectangles is generated.
+
+enum {DEFAULT_SIZE = 4096, ROUNDS = 3, MAX_DEPTH = 6, EDITS = 100,
+      STREAM_ROWS = 256};
+
+static const char *layout_names[] = {"row-major", "tiled"};
+
+// A region detector, the layout of the image it is run on and the number of
+// threads it may use.
+typedef struct detector
+{
+  const char *name;
+  void (*find)(list_t *regions, image_t *image, int threads);
+  image_layout_t layout;
+  int threads;
+} detector_t;
+
+static void sequential(list_t *regions, image_t *image, int threads)
+{
+  (void) threads;
+  find_regions(regions, image);
+}
+
+static void quadtree(list_t *regions, image_t *image, int threads)
+{
+  (void) threads;
+  find_regions_quadtree(regions, image);
+}
+
+static void scanline(list_t *regions, image_t *image, int threads)
+{
+  (void) threads;
+  scanline_find_regions(regions, image);
+}
+
+// The first detector is the reference the others are checked against. The
+// parallel detector is run with 1 to 64 threads to show how it scales.
+static const detector_t detectors[] =
+{
+  {"find_regions", sequential, IMAGE_ROW_MAJOR, 1},
+  {"find_regions", sequential, IMAGE_TILED, 1},
+  {"quadtree", quadtree, IMAGE_ROW_MAJOR, 1},
+  {"quadtree", quadtree, IMAGE_TILED, 1},
+  {"scanline", scanline, IMAGE_ROW_MAJOR, 1},
+  {"scanline", scanline, IMAGE_TILED, 1},
+  {"parallel", scanline_find_regions_parallel, IMAGE_ROW_MAJOR, 1},
+  {"parallel", scanline_find_regions_parallel, IMAGE_ROW_MAJOR, 2},
+  {"parallel", scanline_find_regions_parallel, IMAGE_ROW_MAJOR, 4},
+  {"parallel", scanline_find_regions_parallel, IMAGE_ROW_MAJOR, 8},
+  {"parallel", scanline_find_regions_parallel, IMAGE_ROW_MAJOR, 16},
+  {"parallel", scanline_find_regions_parallel, IMAGE_ROW_MAJOR, 32},
+  {"parallel", scanline_find_regions_parallel, IMAGE_ROW_MAJOR, 64},
+  {"parallel", scanline_find_regions_parallel, IMAGE_TILED, 64},
+};
+
+// Returns a monotonic time in seconds.
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Places up to 12 children, separated by at least a pixel, inside the
+// w x h rectangle at (x, y) of "image" whose pixels are "value", and then
+// recursively inside each child.
+static void place_children(image_t *image, int x, int y, int w, int h,
+                           uint8_t value, int depth)
+{
+  if (depth > MAX_DEPTH || w < 5 || h < 5)
+  {
+    return;
+  }
+  int wanted = (depth == 1 ? 6 : 0) + rand() % (depth == 1 ? 6 : 12);
+  region_t placed[12];
+  int count = 0;
+  for (int attempt = 0; attempt < 20 * wanted && count < wanted; attempt++)
+  {
+    region_t child;
+    child.extent.width = 1 + rand() % (w / 3 > 1 ? w / 3 - 1 : 1);
+    child.extent.height = 1 + rand() % (h / 3 > 1 ? h / 3 - 1 : 1);
+    if (w - child.extent.width < 2 || h - child.extent.height < 2)
+    {
+      continue;
+    }
+    child.position.x = x + 1 + rand() % (w - child.extent.width - 1);
+    child.position.y = y + 1 + rand() % (h - child.extent.height - 1);
+    int clear = 1;
+    for (int i = 0; i < count && clear; i++)
+    {
+      clear = child.position.x + child.extent.width + 1 <= placed[i].position.x
+              || placed[i].position.x + placed[i].extent.width + 1
+                 <= child.position.x
+              || child.position.y + child.extent.height + 1
+                 <= placed[i].position.y
+              || placed[i].position.y + placed[i].extent.height + 1
+                 <= child.position.y;
+    }
+    if (!clear)
+    {
+      continue;
+    }
+    uint8_t child_value = (value + 1 + rand() % 255) & 0xff;
+    placed[count++] = child;
+    image_fill_region(image, &child, child_value);
+    place_children(image, child.position.x, child.position.y,
+                   child.extent.width, child.extent.height, child_value,
+                   depth + 1);
+  }
+}
+
+// Returns a width x height image of randomly nested rectangles.
+static image_t *generate(int width, int height)
+{
+  image_t *image;
+  image_error_t res = init_image(&image, width, height, GRAY, 255);
+  if (res != IMG_OK)
+  {
+    image_print_error(res);
+    exit(EXIT_FAILURE);
+  }
+  srand(1);
+  uint8_t value = rand() & 0xff;
+  image_fill_rect(image, 0, 0, width, height, value);
+  place_children(image, 0, 0, width, height, value, 1);
+  return image;
+}
+
+// Returns 1 if "a" and "b" hold the same regions in the same order.
+static int same_regions(list_t *a, list_t *b)
+{
+  list_iter i = list_begin(a);
+  list_iter j = list_begin(b);
+  for (; i != list_end(a) && j != list_end(b);
+       i = list_iter_next(i), j = list_iter_next(j))
+  {
+    if (memcmp(list_iter_value(i), list_iter_value(j), sizeof(region_t)) != 0)
+    {
+      return 0;
+    }
+  }
+  return i == list_end(a) && j == list_end(b);
+}
+
+// Builds the region tree of "source" during detection and from the list
+// "reference", checks that they agree, and looks up every region by its
+// corner. Returns the number of failed checks.
+static int bench_tree(image_t *source, list_t *reference)
+{
+  region_tree_t detected;
+  region_tree_t indexed;
+  list_t regions;
+  list_init(&regions);
+  double start = now();
+  scanline_find_region_tree(&detected, &regions, source);
+  double detect = now() - start;
+  start = now();
+  int ok = region_tree_init_from_list(&indexed, reference);
+  double build = now() - start;
+  if (!ok)
+  {
+    perror("region_tree_init_from_list");
+    exit(EXIT_FAILURE);
+  }
+
+  ok = detected.count == indexed.count;
+  for (int i = 0; ok && i < detected.count; i++)
+  {
+    const region_node_t *a = &detected.nodes[i];
+    const region_node_t *b = &indexed.nodes[i];
+    ok = memcmp(a->region, b->region, sizeof(region_t)) == 0
+         && a->child_count == b->child_count
+         && (a->parent == NULL) == (b->parent == NULL)
+         && (a->parent == NULL
+             || a->parent - detected.nodes == b->parent - indexed.nodes);
+  }
+
+  start = now();
+  for (int i = 0; ok && i < indexed.count; i++)
+  {
+    const region_t *region = indexed.nodes[i].region;
+    ok = region_tree_at(&indexed, region->position.x, region->position.y)
+         == &indexed.nodes[i];
+  }
+  double lookup = now() - start;
+
+  printf("\n%-28s %10.4f  %s\n", "scanline with tree", detect,
+         ok ? "ok" : "MISMATCH");
+  printf("%-28s %10.4f\n", "tree from list", build);
+  printf("%-28s %10.4f  (%.2f us each)\n", "region_tree_at() x regions",
+         lookup, indexed.count > 0 ? lookup * 1e6 / indexed.count : 0.0);
+
+  region_tree_destroy(&detected);
+  region_tree_destroy(&indexed);
+  list_destroy(&regions);
+  return !ok;
+}
+
+// Finds the regions of "source" with find_regions_quadtree_sat() and reports
+// the pixels its summed-area table read and the bytes its tile tables took,
+// next to the 16 bytes per pixel of a table of the whole image. Returns the
+// number of failed checks.
+static int bench_quadtree(image_t *source, list_t *reference)
+{
+  region_sat_t sat;
+  if (!region_sat_init(&sat, source))
+  {
+    perror("region_sat_init");
+    exit(EXIT_FAILURE);
+  }
+  list_t regions;
+  list_init(&regions);
+  double start = now();
+  find_regions_quadtree_sat(&regions, &sat);
+  double elapsed = now() - start;
+  int ok = same_regions(reference, &regions);
+  size_t pixels = (size_t) source->width * source->height;
+
+  printf("\n%-28s %10.4f  %s\n", "quadtree", elapsed,
+         ok ? "ok" : "MISMATCH");
+  printf("%-28s %10zu  (of %zu)\n", "pixels read", sat.pixels_read, pixels);
+  printf("%-28s %10zu  (whole table %zu)\n", "table bytes", sat.table_bytes,
+         16 * pixels);
+
+  region_sat_free(&sat);
+  list_destroy(&regions);
+  return !ok;
+}
+
+// Finds the regions of "source" into a list with and without an arena, and
+// reports the objects allocated for them, the calls to malloc() that took,
+// and the time taken to find and to free them. Without an arena, every region
+// and list element is a malloc() of its own. Returns the number of failed
+// checks.
+static int bench_arena(image_t *source)
+{
+  static const char *names[] = {"malloc", "arena"};
+  region_arena_t arena;
+  region_arena_init(&arena);
+  list_t lists[2];
+  list_init(&lists[0]);
+  list_init_arena(&lists[1], &arena);
+
+  double detect[2];
+  for (int i = 0; i < 2; i++)
+  {
+    double start = now();
+    scanline_find_regions(&lists[i], source);
+    detect[i] = now() - start;
+  }
+  size_t count = 0;
+  for (list_iter i = list_begin(&lists[0]); i != list_end(&lists[0]);
+       i = list_iter_next(i))
+  {
+    count++;
+  }
+  int ok = same_regions(&lists[0], &lists[1]);
+  size_t objects[2] = {2 * count, arena.allocations};
+  size_t mallocs[2] = {2 + 2 * count, 2 + arena.block_count};
+
+  printf("\n%-8s %10s %10s %10s %10s  %s\n", "results", "objects", "mallocs",
+         "detect", "free", "check");
+  for (int i = 0; i < 2; i++)
+  {
+    double start = now();
+    list_destroy(&lists[i]);
+    double destroy = now() - start;
+    printf("%-8s %10zu %10zu %10.4f %10.4f  %s\n", names[i], objects[i],
+           mallocs[i], detect[i], destroy, ok ? "ok" : "MISMATCH");
+  }
+  return !ok;
+}
+
+// Writes "reference" to a file as text, a region at a time with
+// print_region() and with print_regions(), and as a binary region file, and
+// checks the regions read back from its mapping. The files are removed
+// afterwards. Returns the number of failed checks.
+static int bench_output(list_t *reference)
+{
+  static const char *text_path = "bench_regions.txt";
+  static const char *binary_path = "bench_regions.rgn";
+  static const char *names[] = {"print_region", "print_regions", "binary"};
+  double elapsed[3];
+  long sizes[3];
+  for (int i = 0; i < 3; i++)
+  {
+    double start = now();
+    if (i < 2)
+    {
+      FILE *out = fopen(text_path, "w");
+      if (out == NULL)
+      {
+        perror(text_path);
+        exit(EXIT_FAILURE);
+      }
+      if (i == 0)
+      {
+        for (list_iter j = list_begin(reference); j != list_end(reference);
+             j = list_iter_next(j))
+        {
+          print_region(out, list_iter_value(j));
+        }
+      }
+      else
+      {
+        print_regions(out, reference);
+      }
+      sizes[i] = ftell(out);
+      fclose(out);
+    }
+    else if (!region_file_write(binary_path, reference))
+    {
+      exit(EXIT_FAILURE);
+    }
+    elapsed[i] = now() - start;
+  }
+  remove(text_path);
+
+  region_file_t file;
+  double start = now();
+  int ok = region_file_open(&file, binary_path);
+  size_t read = 0;
+  list_iter j = list_begin(reference);
+  for (; ok && read < file.count && j != list_end(reference);
+       read++, j = list_iter_next(j))
+  {
+    region_t region;
+    region_file_get(&file, read, &region);
+    ok = memcmp(&region, list_iter_value(j), sizeof(region_t)) == 0;
+  }
+  ok = ok && read == file.count && j == list_end(reference);
+  double mapped = now() - start;
+  sizes[2] = (long) file.size;
+  region_file_close(&file);
+  remove(binary_path);
+
+  printf("\n%-20s %12s %10s  %s\n", "output", "bytes", "seconds", "check");
+  for (int i = 0; i < 3; i++)
+  {
+    printf("%-20s %12ld %10.4f  %s\n", names[i], sizes[i], elapsed[i],
+           i < 2 ? "" : ok ? "ok" : "MISMATCH");
+  }
+  printf("%-20s %12ld %10.4f  %s\n", "mapped read", sizes[2], mapped,
+         ok ? "ok" : "MISMATCH");
+  return !ok;
+}
+
+// Writes "source", whose regions are "reference", to a binary PGM file, and
+// finds its regions from the image read with image_read() and from the file
+// streamed a band at a time. Checks that both match "reference". The file is
+// removed afterwards. Returns the number of failed checks.
+static int bench_stream(image_t *source, list_t *reference)
+{
+  static const char *path = "bench_regions.pgm";
+  static const char *names[] = {"image_read", "stream"};
+  image_error_t res = image_write(path, source, PGM_FORMAT);
+  if (res != IMG_OK)
+  {
+    image_print_error(res);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("\n%-20s %10s  %s\n", "reader", "seconds", "check");
+  int failures = 0;
+  for (int i = 0; i < 2; i++)
+  {
+    list_t regions;
+    list_init(&regions);
+    double start = now();
+    if (i == 0)
+    {
+      image_t *image;
+      res = image_read(path, &image);
+      if (res == IMG_OK)
+      {
+        scanline_find_regions(&regions, image);
+        image_free(image);
+      }
+    }
+    else
+    {
+      image_stream_t *stream;
+      res = image_stream_open(path, STREAM_ROWS, &stream);
+      if (res == IMG_OK)
+      {
+        scanline_find_regions_stream(&regions, stream);
+        res = image_stream_close(stream);
+      }
+    }
+    double elapsed = now() - start;
+    if (res != IMG_OK)
+    {
+      image_print_error(res);
+      exit(EXIT_FAILURE);
+    }
+    int ok = same_regions(reference, &regions);
+    failures += !ok;
+    printf("%-20s %10.4f  %s\n", names[i], elapsed, ok ? "ok" : "MISMATCH");
+    list_destroy(&regions);
+  }
+  remove(path);
+  return failures;
+}
+
+// Renders "reference", the regions of "source", by painting each region in
+// turn and with spans that write each pixel once, and checks that the images
+// are the same. Returns the number of failed checks.
+static int bench_render(image_t *source, list_t *reference)
+{
+  static const char *names[] = {"render_regions", "spans"};
+  image_t *images[2];
+  double elapsed[2];
+  uint8_t colours[REGION_COLOURS];
+  region_colour_table(colours, REGION_COLOURS, region_colour);
+  for (int i = 0; i < 2; i++)
+  {
+    image_error_t res = init_image(&images[i], source->width, source->height,
+                                   GRAY, 255);
+    if (res != IMG_OK)
+    {
+      image_print_error(res);
+      exit(EXIT_FAILURE);
+    }
+    double start = now();
+    if (i == 0)
+    {
+      render_regions(images[i], reference, region_colour);
+    }
+    else
+    {
+      render_regions_spans(images[i], reference, colours, REGION_COLOURS);
+    }
+    elapsed[i] = now() - start;
+  }
+  int ok = memcmp(images[0]->pixelsData, images[1]->pixelsData,
+                  (size_t) images[0]->widthStep * images[0]->height) == 0;
+
+  printf("\n%-20s %10s  %s\n", "renderer", "seconds", "check");
+  for (int i = 0; i < 2; i++)
+  {
+    printf("%-20s %10.4f  %s\n", names[i], elapsed[i], ok ? "ok" : "MISMATCH");
+    image_free(images[i]);
+  }
+  return !ok;
+}
+
+// Makes a random change to a region of "image" whose regions are "regions":
+// fills it with a new value or with that of its parent, or adds a child to it
+// if it has none. Stores the rectangle changed in "changed" and returns 1, or
+// returns 0 if the region chosen could not be changed.
+static int edit_image(image_t *image, list_t *regions, region_t *changed)
+{
+  int count = 0;
+  for (list_iter i = list_begin(regions); i != list_end(regions);
+       i = list_iter_next(i))
+  {
+    count++;
+  }
+  if (count < 2)
+  {
+    return 0;
+  }
+  int chosen = 1 + rand() % (count - 1);
+  list_iter i = list_begin(regions);
+  while (chosen-- > 0)
+  {
+    i = list_iter_next(i);
+  }
+  const region_t *region = list_iter_value(i);
+  int x = region->position.x;
+  int y = region->position.y;
+  int w = region->extent.width;
+  int h = region->extent.height;
+  // Generated and edited regions never touch their parent's edges, so the
+  // pixel to the left of a region is its parent's.
+  uint8_t parent = get_pixel(image, x - 1, y);
+  uint8_t value = get_pixel(image, x, y);
+  *changed = *region;
+
+  switch (rand() % 3)
+  {
+  case 0:
+    image_fill_region(image, changed,
+                      (parent + 1 + rand() % 255) & 0xff);
+    return 1;
+  case 1:
+    image_fill_region(image, changed, parent);
+    return 1;
+  default:
+    if (w < 3 || h < 3)
+    {
+      return 0;
+    }
+    for (int py = y; py < y + h; py++)
+    {
+      for (int px = x; px < x + w; px++)
+      {
+        if (get_pixel(image, px, py) != value)
+        {
+          return 0;
+        }
+      }
+    }
+    changed->extent.width = 1 + rand() % (w - 2);
+    changed->extent.height = 1 + rand() % (h - 2);
+    changed->position.x = x + 1 + rand() % (w - 1 - changed->extent.width);
+    changed->position.y = y + 1 + rand() % (h - 1 - changed->extent.height);
+    image_fill_region(image, changed, (value + 1 + rand() % 255) & 0xff);
+    return 1;
+  }
+}
+
+// Edits a copy of "source", whose regions are "reference", EDITS times,
+// updating its regions with update_regions() after each change and checking
+// them against scanline_find_regions(), and at the end against
+// find_regions(). Returns the number of failed checks.
+static int bench_update(image_t *source, list_t *reference)
+{
+  image_t *image;
+  image_error_t res = init_image(&image, source->width, source->height,
+                                 source->nChannels, source->depth);
+  if (res != IMG_OK)
+  {
+    image_print_error(res);
+    exit(EXIT_FAILURE);
+  }
+  memcpy(image->pixelsData, source->pixelsData,
+         (size_t) source->widthStep * source->height);
+  region_arena_t arena;
+  region_arena_init(&arena);
+  list_t regions;
+  list_init_arena(&regions, &arena);
+  for (list_iter i = list_begin(reference); i != list_end(reference);
+       i = list_iter_next(i))
+  {
+    region_t *copy = list_allocate_region(&regions);
+    *copy = *list_iter_value(i);
+    list_append(&regions, copy);
+  }
+  region_tree_t tree;
+  if (!region_tree_init_from_list(&tree, &regions))
+  {
+    perror("region_tree_init_from_list");
+    exit(EXIT_FAILURE);
+  }
+
+  srand(2);
+  int edits = 0;
+  int ok = 1;
+  size_t changed_pixels = 0;
+  size_t scanned_pixels = 0;
+  double update = 0.0;
+  double full = 0.0;
+  for (int attempt = 0; ok && edits < EDITS && attempt < 10 * EDITS;
+       attempt++)
+  {
+    region_t changed;
+    if (!edit_image(image, &regions, &changed))
+    {
+      continue;
+    }
+    edits++;
+    changed_pixels += (size_t) changed.extent.width * changed.extent.height;
+    double start = now();
+    scanned_pixels += update_regions(&regions, &tree, image,
+                                     &changed.position, &changed.extent);
+    update += now() - start;
+
+    // The check's regions come from an arena, so that freeing them leaves
+    // no work for malloc() to do in the next update.
+    region_arena_t found_arena;
+    region_arena_init(&found_arena);
+    list_t found;
+    list_init_arena(&found, &found_arena);
+    start = now();
+    scanline_find_regions(&found, image);
+    full += now() - start;
+    ok = same_regions(&regions, &found);
+    list_destroy(&found);
+  }
+  if (ok)
+  {
+    list_t found;
+    list_init(&found);
+    find_regions(&found, image);
+    ok = same_regions(&regions, &found);
+    list_destroy(&found);
+  }
+
+  printf("\n%-8s %12s %12s %10s %10s  %s\n", "edits", "changed px",
+         "scanned px", "update", "rescan", "check");
+  printf("%-8d %12zu %12zu %10.4f %10.4f  %s\n", edits, changed_pixels,
+         scanned_pixels, update, full, ok ? "ok" : "MISMATCH");
+  region_tree_destroy(&tree);
+  list_destroy(&regions);
+  image_free(image);
+  return !ok;
+}
+
+int main(int argc, char **argv)
+{
+  image_t *source;
+  if (argc == 2)
+  {
+    image_error_t res = image_read(argv[1], &source);
+    if (res != IMG_OK)
+    {
+      image_print_error(res);
+      return EXIT_FAILURE;
+    }
+  }
+  else if (argc == 3 || argc == 1)
+  {
+    source = generate(argc == 3 ? atoi(argv[1]) : DEFAULT_SIZE,
+                      argc == 3 ? atoi(argv[2]) : DEFAULT_SIZE);
+  }
+  else
+  {
+    fprintf(stderr, "Usage: %s [input_image | width height]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  list_t reference;
+  int failures = 0;
+  double megapixels = source->width * (double) source->height / 1e6;
+  printf("%dx%d image\n", source->width, source->height);
+  printf("%-13s %-10s %7s %8s %10s %8s  %s\n", "detector", "layout",
+         "threads", "regions", "seconds", "MP/s", "check");
+  for (size_t d = 0; d < sizeof(detectors) / sizeof(detectors[0]); d++)
+  {
+    const detector_t *detector = &detectors[d];
+    // find_regions() erases the regions it finds, so every round scans a
+    // fresh copy, made outside the timed section.
+    double best = 0.0;
+    list_t regions;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+      image_t *image;
+      image_error_t res = init_image(&image, source->width, source->height,
+                                     source->nChannels, source->depth);
+      if (res == IMG_OK)
+      {
+        memcpy(image->pixelsData, source->pixelsData,
+               (size_t) source->widthStep * source->height);
+        res = image_set_layout(image, detector->layout);
+      }
+      if (res != IMG_OK)
+      {
+        image_print_error(res);
+        return EXIT_FAILURE;
+      }
+      if (round > 0)
+      {
+        list_destroy(&regions);
+      }
+      list_init(&regions);
+      double start = now();
+      detector->find(&regions, image, detector->threads);
+      double elapsed = now() - start;
+      if (round == 0 || elapsed < best)
+      {
+        best = elapsed;
+      }
+      image_free(image);
+    }
+
+    int count = 0;
+    for (list_iter i = list_begin(&regions); i != list_end(&regions);
+         i = list_iter_next(i))
+    {
+      count++;
+    }
+    int ok = 1;
+    if (d == 0)
+    {
+      reference = regions;
+    }
+    else
+    {
+      ok = same_regions(&reference, &regions);
+      list_destroy(&regions);
+    }
+    failures += !ok;
+    printf("%-13s %-10s %7d %8d %10.4f %8.1f  %s\n", detector->name,
+           layout_names[detector->layout], detector->threads, count, best,
+           megapixels / best, ok ? "ok" : "MISMATCH");
+  }
+
+  failures += bench_tree(source, &reference);
+  failures += bench_quadtree(source, &reference);
+  failures += bench_arena(source);
+  failures += bench_output(&reference);
+  failures += bench_stream(source, &reference);
+  failures += bench_render(source, &reference);
+  failures += bench_update(source, &reference);
+  list_destroy(&reference);
+  image_free(source);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -26,6 +26,7 @@ static list_elem_t *alloc_list_elem()
 // Initialises the list_t so it can be used with other list functions.
 void list_init(list_t *list)
 {
+  list->arena = NULL;
   list->header = alloc_list_elem();
   list->footer = alloc_list_elem();
   list->header->next = list->footer;
@@ -88,34 +89,182 @@ void list_apply_function(list_t *list, region_function_t f)
 ////////////////TO BE IMPLEMENTED///////////////////////////////////
 ///////////////////////////////////////////////////////////////////
 
+// Links "elem", holding "region", into a list before the element pointed to
+// by "iter".
+static void link_elem(list_iter iter, list_elem_t *elem, region_t *region)
+{
+  elem->region = region;
+  elem->prev = iter->prev;
+  elem->next = iter;
+  iter->prev->next = elem;
+  iter->prev = elem;
+}
+
+// Allocates an element for "list": from its arena if it has one.
+static list_elem_t *list_alloc_elem(list_t *list)
+{
+  if (list->arena != NULL)
+  {
+    return region_arena_allocate(list->arena, sizeof(list_elem_t));
+  }
+  return alloc_list_elem();
+}
+
 // Inserts "region" into "list" before the element pointed to by "iter".
+//
+// The element is allocated with malloc(): the iterator does not lead to the
+// list's arena, which would never free it, so lists with an arena must use
+// list_insert_at() instead.
 void list_insert(list_iter iter, region_t *region)
 {
-  list_elem_t *new_elem = alloc_list_elem();
-  new_elem->region = region;
-  new_elem->prev = iter->prev;
-  new_elem->next = iter;
-  iter->prev->next = new_elem;
-  iter->prev = new_elem;
+  link_elem(iter, alloc_list_elem(), region);
 }
 
 
 // Inserts "region" into "list" using the ordering defined by the function
 // region_compare().
+//
+// The search starts from the end of the list, so regions that arrive in
+// (or close to) ascending order are inserted in constant time.
 void list_insert_ascending(list_t *list, region_t *region)
 {
-  list_iter iter = list_begin(list);
-  while(iter != list_end(list) && region_compare(iter->region, region))
+  list_iter iter = list_end(list);
+  while (iter != list_begin(list)
+         && !region_compare(list_iter_prev(iter)->region, region))
+  {
+    iter = list_iter_prev(iter);
+  }
+  link_elem(iter, list_alloc_elem(list), region);
+}
+
+// Appends "region" to the end of "list" in constant time, without regard to
+// ordering.
+void list_append(list_t *list, region_t *region)
+{
+  link_elem(list_end(list), list_alloc_elem(list), region);
+}
+
+// Inserts "region" into "list" before the element pointed to by "iter",
+// allocating the element from the list's arena if it has one.
+void list_insert_at(list_t *list, list_iter iter, region_t *region)
+{
+  link_elem(iter, list_alloc_elem(list), region);
+}
+
+// Removes the element pointed to by "iter" from "list" and returns an
+// iterator to the element that followed it.
+list_iter list_erase(list_t *list, list_iter iter)
+{
+  list_iter next = iter->next;
+  iter->prev->next = next;
+  next->prev = iter->prev;
+  if (list->arena == NULL)
+  {
+    region_destroy(iter->region);
+    free(iter);
+  }
+  return next;
+}
+
+// Initialises the list_t to allocate its elements and regions from "arena",
+// which it then owns.
+void list_init_arena(list_t *list, region_arena_t *arena)
+{
+  list_init(list);
+  list->arena = arena;
+}
+
+// Allocates a region to be added to "list": from its arena if it has one,
+// otherwise with region_allocate().
+region_t *list_allocate_region(list_t *list)
+{
+  if (list->arena != NULL)
+  {
+    return region_arena_allocate(list->arena, sizeof(region_t));
+  }
+  return region_allocate();
+}
+
+// Merges the sorted, NULL-terminated chains "a" and "b", linked through
+// "next" only. Elements of "a" come first among equal ones.
+static list_elem_t *merge_chains(list_elem_t *a, list_elem_t *b)
+{
+  list_elem_t head;
+  list_elem_t *tail = &head;
+  while (a != NULL && b != NULL)
+  {
+    if (region_compare(b->region, a->region))
+    {
+      tail->next = b;
+      b = b->next;
+    }
+    else
+    {
+      tail->next = a;
+      a = a->next;
+    }
+    tail = tail->next;
+  }
+  tail->next = a != NULL ? a : b;
+  return head.next;
+}
+
+// Sorts "list" into the order defined by region_compare() with a bottom-up
+// merge sort: runs of doubling length are merged in "pending", where slot i
+// holds a sorted chain of 2^i elements, or NULL.
+void list_sort(list_t *list)
+{
+  list_elem_t *pending[64] = {NULL};
+  list_elem_t *elem = list_begin(list);
+  while (elem != list_end(list))
+  {
+    list_elem_t *chain = elem;
+    elem = elem->next;
+    chain->next = NULL;
+    int i = 0;
+    for (; pending[i] != NULL; i++)
+    {
+      chain = merge_chains(pending[i], chain);
+      pending[i] = NULL;
+    }
+    pending[i] = chain;
+  }
+
+  list_elem_t *sorted = NULL;
+  for (int i = 0; i < 64; i++)
   {
-    iter = list_iter_next(iter);
+    if (pending[i] != NULL)
+    {
+      sorted = merge_chains(pending[i], sorted);
+    }
   }
-  list_insert(iter, region);
+
+  // Restore the "prev" links and the sentinels.
+  list_elem_t *prev = list->header;
+  for (; sorted != NULL; sorted = sorted->next)
+  {
+    prev->next = sorted;
+    sorted->prev = prev;
+    prev = sorted;
+  }
+  prev->next = list->footer;
+  list->footer->prev = prev;
 }
 
 // Reclaims all memory used by the list_t data structure including any
 // contained region_t elements.
+//
+// The elements and regions of a list with an arena are freed all at once by
+// releasing the arena; only the sentinels are freed individually.
 void list_destroy(list_t *list)
 {
+  if (list->arena != NULL)
+  {
+    region_arena_release(list->arena);
+    free(list->header);
+    free(list->footer);
+    return;
+  }
   list_apply_function(list, region_destroy);
   list_iter iter = list->header;
   while (iter->next != NULL) {
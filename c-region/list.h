@@ -2,6 +2,7 @@
 #define _LIST_H_
 
 #include "region.h"
+#include "arena.h"
 #include <stdio.h>
 
 /////ALL THESE FUNCTIONS ARE PROVIDED FOR YOU/////////////////////
@@ -52,6 +53,36 @@ void list_insert(list_iter iter, region_t *region);
 // region_compare().
 void list_insert_ascending(list_t *list, region_t  *region);
 
+// Appends "region" to the end of "list" in constant time, without regard to
+// ordering. Use list_sort() once all regions have been appended.
+void list_append(list_t *list, region_t *region);
+
+// Sorts "list" into the order defined by region_compare() in O(n log n) time.
+// The sort is stable: regions that compare equal keep their relative order.
+void list_sort(list_t *list);
+
+// Initialises the list_t as list_init() does, but allocates its elements, and
+// the regions of list_allocate_region(), from "arena". The list then owns the
+// arena: list_destroy() releases it, freeing everything at once. Such a list
+// must not grow through list_insert(), which takes no list and so mallocs its
+// element; use list_insert_at() instead.
+void list_init_arena(list_t *list, region_arena_t *arena);
+
+// Inserts "region" into "list" before the element pointed to by "iter", as
+// list_insert() does, but allocating the element from the list's arena if it
+// has one.
+void list_insert_at(list_t *list, list_iter iter, region_t *region);
+
+// Removes the element pointed to by "iter" from "list" and returns an
+// iterator to the element that followed it. The element and its region are
+// freed, unless they belong to the list's arena, which keeps them until it is
+// released.
+list_iter list_erase(list_t *list, list_iter iter);
+
+// Allocates a region to be added to "list": from its arena if it has one,
+// otherwise with region_allocate().
+region_t *list_allocate_region(list_t *list);
+
 // Reclaims all memory used by the list_t data structure. region_t*
 // elements stored in the list are *not* reclaimed by this function.
 void list_destroy(list_t *list);
@@ -1,9 +1,15 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
 #include "image.h"
 #include "region.h"
+#include "region_file.h"
+#include "scanline.h"
 #include "list.h"
 #include "typedefs.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 
 //////////////////////////////////////////////////////////////
 //DO NOT MODIFY ANYTHING FROM THIS FILE///////////////////////
@@ -11,39 +17,112 @@
 
 static const char *pgm_output = "output.pgm";
 static const char *txt_output = "regions.txt";
+static const char *bin_output = "regions.rgn";
+static const char *pyramid_output = "output";
 
 int main(int argc, char **argv)
 {
-  if (argc == 2)
+  int pyramid_levels = 0;
+  int rle_output = 0;
+  int binary_output = 0;
+  image_layout_t layout = IMAGE_ROW_MAJOR;
+  const char *output_dir = NULL;
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while ((opt = getopt(argc, argv, "p:rbto:j:")) != -1)
+  {
+    if (opt == 'p')
+    {
+      pyramid_levels = atoi(optarg);
+    }
+    else if (opt == 'r')
+    {
+      rle_output = 1;
+    }
+    else if (opt == 'b')
+    {
+      binary_output = 1;
+    }
+    else if (opt == 't')
+    {
+      layout = IMAGE_TILED;
+    }
+    else if (opt == 'o')
+    {
+      output_dir = optarg;
+    }
+    else if (opt == 'j')
+    {
+      threads = atoi(optarg);
+    }
+    else
+    {
+      argc = 0;
+    }
+  }
+
+  if (output_dir != NULL && argc > optind)
+  {
+    // Batch mode: every input gets its own outputs in output_dir.
+    batch_options_t options;
+    options.output_dir = output_dir;
+    options.threads = threads;
+    options.rle_output = rle_output;
+    options.binary_output = binary_output;
+    options.layout = layout;
+    int failures = batch_run(&options, argv + optind, argc - optind);
+    if (failures != 0)
+    {
+      fprintf(stderr, "%d image(s) could not be processed.\n", failures);
+      return EXIT_FAILURE;
+    }
+  }
+  else if (argc == optind + 1)
   {
 
     // Load image
-    const char *img_in_filename = argv[1];
+    const char *img_in_filename = argv[optind];
     image_t *img_in = NULL;
-    image_error_t img_err = image_read(img_in_filename, &img_in);
+    image_error_t img_err = image_read_mapped(img_in_filename, &img_in);
+    if (img_err == IMG_OK)
+    {
+      img_err = image_set_layout(img_in, layout);
+    }
     if(img_err)
     {
       image_print_error(img_err);
       exit(EXIT_FAILURE);
     }
 
-    // Initalise regions list
+    // Initalise regions list; its regions are freed together with it.
+    region_arena_t arena;
+    region_arena_init(&arena);
     list_t regions;
-    list_init(&regions);
+    list_init_arena(&regions, &arena);
 
     // Identify and print regions
-    find_regions(&regions, img_in);
+    scanline_find_regions(&regions, img_in);
     print_regions(stdout, &regions);
 
-    // Write regions description to text file.
-    FILE *text_out = fopen(txt_output,"w+");
-    if (text_out == NULL)
+    // Write regions description to a binary region file or a text file.
+    if (binary_output)
     {
-      perror("Text output file");
-      exit(EXIT_FAILURE);
+      if (!region_file_write(bin_output, &regions))
+      {
+        exit(EXIT_FAILURE);
+      }
+    }
+    else
+    {
+      FILE *text_out = fopen(txt_output,"w+");
+      if (text_out == NULL)
+      {
+        perror("Text output file");
+        exit(EXIT_FAILURE);
+      }
+      print_regions(text_out, &regions);
+      fclose(text_out);
     }
-    print_regions(text_out, &regions);
-    fclose(text_out);
 
 
     // Allocate memory for output image
@@ -58,13 +137,32 @@ int main(int argc, char **argv)
     render_regions(img_out, &regions, region_colour);
 
     // Write output image to file
-    img_err = image_write(pgm_output, img_out, PGM_FORMAT);
+    if (rle_output)
+    {
+      img_err = image_write_rle(pgm_output, img_out);
+    }
+    else
+    {
+      img_err = image_write(pgm_output, img_out, PGM_FORMAT);
+    }
     if(img_err)
     {
        image_print_error(img_err);
        exit(EXIT_FAILURE);
     }
 
+    // Write downsampled previews of the output image.
+    if (pyramid_levels > 0)
+    {
+      img_err = image_write_pyramid(pyramid_output, img_out, pyramid_levels,
+                                    sysconf(_SC_NPROCESSORS_ONLN));
+      if(img_err)
+      {
+        image_print_error(img_err);
+        exit(EXIT_FAILURE);
+      }
+    }
+
     // Deallocate memory for regions and region list.
     list_destroy(&regions);
 
@@ -74,10 +172,24 @@ int main(int argc, char **argv)
   }
   else
   {
-    fprintf(stderr, "Usage: %s input_image\n", argv[0]);
+    fprintf(stderr, "Usage: %s [-r] [-b] [-t] [-p levels]"
+            " input_image\n", argv[0]);
+    fprintf(stderr, "       %s [-r] [-b] [-t] [-j threads] -o output_dir"
+            " input...\n", argv[0]);
     fprintf(stderr, "Textual description of regions will be written to %s"
             " and standard output.\n", txt_output);
     fprintf(stderr, "Re-rendered regions will be written to %s.\n", pgm_output);
+    fprintf(stderr, "With -r, it is run-length encoded; any input image may"
+            " be too.\n");
+    fprintf(stderr, "With -b, regions are written to %s, a binary region"
+            " file, instead.\n", bin_output);
+    fprintf(stderr, "With -t, the input is scanned in tiled memory layout.\n");
+    fprintf(stderr, "With -p, downsampled previews will be written to"
+            " %s_level<n>.pgm.\n", pyramid_output);
+    fprintf(stderr, "With -o, each input image, directory of images or"
+            " @list file of image paths\nis processed on -j threads, writing"
+            " <name>.txt (or <name>.rgn) and <name>.pgm to output_dir\n"
+            "(default: one thread per CPU).\n");
     return EXIT_FAILURE;
   }
 
@@ -1,11 +1,14 @@
 #include "region.h"
 #include "image.h"
+#include "kernels.h"
 #include "typedefs.h"
 #include "list.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
+#include <string.h>
 
 /////ALL THESE FUNCTIONS ARE PROVIDED FOR YOU/////////////////////
 /////DO NOT MODIFY THEM///////////////////////////////////////////
@@ -62,14 +65,17 @@ void print_region(FILE *out, const region_t *region)
 // comparison function region_compare() is preserved.
 void find_regions(list_t *regions, image_t* image)
 {
-  region_t *image_region = region_allocate();
+  region_t *image_region = list_allocate_region(regions);
 
   image_region->depth = 0;
   init_point(&image_region->position, 0, 0);
   init_extent(&image_region->extent, image->width, image->height);
 
-  list_insert_ascending(regions, image_region);
+  // Regions are found column by column, so collect them unordered and sort
+  // them once at the end.
+  list_append(regions, image_region);
   find_sub_regions(regions, image, image_region);
+  list_sort(regions);
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -110,17 +116,92 @@ int region_compare(const region_t *r1, const region_t *r2)
   return point_compare_less(&(r1->position), &(r2->position));
 }
 
+// Size of the buffer print_regions() formats lines in, and the longest line
+// it formats.
+enum {REGION_TEXT_BUFFER = 1 << 20, REGION_TEXT_LINE = 128};
+
+// Copies "text" to "out" and returns the end of the copy.
+static char *format_text(char *out, const char *text)
+{
+  while (*text != '\0')
+  {
+    *out++ = *text++;
+  }
+  return out;
+}
+
+// Writes "value" to "out" in decimal, as "%i" does, and returns the end.
+static char *format_int(char *out, int value)
+{
+  char digits[10];
+  unsigned magnitude = value < 0 ? 0u - (unsigned) value : (unsigned) value;
+  int count = 0;
+  if (value < 0)
+  {
+    *out++ = '-';
+  }
+  do
+  {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  while (count > 0)
+  {
+    *out++ = digits[--count];
+  }
+  return out;
+}
+
+// Writes the "size" bytes of "text" to "out", exiting if they cannot all be
+// written.
+static void write_text(FILE *out, const char *text, size_t size)
+{
+  if (fwrite(text, 1, size, out) != size)
+  {
+    perror("print_regions");
+    exit(EXIT_FAILURE);
+  }
+}
+
 // Prints all regions in "regions" to "out".
 // print_region (above) prints a textual description of a region
 // to the supplied FILE*
+//
+// Lines are formatted as print_region() formats them, but without fprintf(),
+// into a buffer of REGION_TEXT_BUFFER bytes that is written out when full.
 void print_regions(FILE *out, list_t *regions)
 {
+  char *buffer = malloc(REGION_TEXT_BUFFER);
+  if (buffer == NULL)
+  {
+    perror("print_regions");
+    exit(EXIT_FAILURE);
+  }
+  char *end = buffer;
   for(list_iter iter = list_begin(regions);
       iter != list_end(regions);
       iter = list_iter_next(iter))
   {
-    print_region(out, iter->region);
+    if (end - buffer > REGION_TEXT_BUFFER - REGION_TEXT_LINE)
+    {
+      write_text(out, buffer, end - buffer);
+      end = buffer;
+    }
+    const region_t *region = iter->region;
+    end = format_text(end, "Region of depth ");
+    end = format_int(end, region->depth);
+    end = format_text(end, " at (");
+    end = format_int(end, region->position.x);
+    end = format_text(end, ", ");
+    end = format_int(end, region->position.y);
+    end = format_text(end, ") of extent (");
+    end = format_int(end, region->extent.width);
+    end = format_text(end, ", ");
+    end = format_int(end, region->extent.height);
+    end = format_text(end, ")\n");
   }
+  write_text(out, buffer, end - buffer);
+  free(buffer);
 }
 
 //
@@ -128,15 +209,22 @@ void print_regions(FILE *out, list_t *regions)
 //
 void image_fill_region(image_t *image, const region_t *region, uint8_t value)
 {
-  int x = region->position.x;
-  int y = region->position.y;
-  for (int xo = 0; xo < region->extent.width; xo++)
-  {
-    for (int yo = 0; yo < region->extent.height; yo++)
-    {
-      set_pixel(image, x + xo, y + yo, value);
-    }
-  }
+  image_fill_rect(image, region->position.x, region->position.y,
+                  region->extent.width, region->extent.height, value);
+}
+
+//
+// Sets the specified region of "view", positioned relative to the view, to the
+// intensity value "value".
+//
+void image_view_fill_region(const image_view_t *view, const region_t *region,
+                            uint8_t value)
+{
+  image_view_t rect = image_view_crop(view, region->position.x,
+                                      region->position.y,
+                                      region->extent.width,
+                                      region->extent.height);
+  image_view_fill(&rect, value);
 }
 
 // Determines the extent of a region.
@@ -145,17 +233,53 @@ void image_fill_region(image_t *image, const region_t *region, uint8_t value)
 // extent: this will be populated with the width and height of a region.
 void find_extent(extent_t *extent, image_t *image, const point_t *position)
 {
+  if (image->layout == IMAGE_ROW_MAJOR)
+  {
+    image_view_t view = image_view(image);
+    find_extent_in_view(extent, &view, position);
+    return;
+  }
   int x = position->x;
   int y = position->y;
   uint8_t value = get_pixel(image, x, y);
+  int xo = 1;
+  int yo = 1;
+  while (x + xo < image->width
+         && image->pixelsData[image_offset(image, x + xo, y)] == value)
+  {
+    xo++;
+  }
+  while (y + yo < image->height
+         && image->pixelsData[image_offset(image, x, y + yo)] == value)
+  {
+    yo++;
+  }
+  extent->width = xo;
+  extent->height = yo;
+}
+
+// Determines the extent of a region that lies within "view".
+// position: the top-left-hand corner of the region, relative to the view.
+// extent: this will be populated with the width and height of a region.
+void find_extent_in_view(extent_t *extent, const image_view_t *view,
+                         const point_t *position)
+{
+  int x = position->x;
+  int y = position->y;
+  uint8_t value = image_view_get_pixel(view, x, y);
   int xo = 0;
   int yo = 0;
   // Assumption: regions cannot overlap edges
-  while (get_pixel(image, x + xo, y) == value)
+  const uint8_t *row = image_view_row(view, y) + x * view->nChannels;
+  if (view->nChannels == 1)
+  {
+    xo = kernel_find_difference(row, view->width - x, value);
+  }
+  while (x + xo < view->width && row[xo * view->nChannels] == value)
   {
     xo++;
   }
-  while (get_pixel(image, x, y + yo) == value)
+  while (y + yo < view->height && row[yo * view->stride] == value)
   {
     yo++;
   }
@@ -164,30 +288,407 @@ void find_extent(extent_t *extent, image_t *image, const point_t *position)
 }
 
 // Finds all regions located in the region "current" of "image" and adds them
-// to "regions".  Regions are added so that ordering according to the
-// comparison function region_compare() is preserved.
+// to the end of "regions", in the order they are found. Sort the list with
+// list_sort() afterwards to order it by region_compare().
 void find_sub_regions(list_t* regions, image_t *image, const region_t *current)
 {
   int x = current->position.x;
   int y = current->position.y;
+  int width = current->extent.width;
+  int height = current->extent.height;
   uint8_t value = get_pixel(image, x, y);
-  for (int xo = 0; xo < current->extent.width; xo++)
+
+  // Most regions have no children: confirm that a row at a time.
+  int yo = 0;
+  while (yo < height && image_row_equals(image, x, y + yo, width, value))
+  {
+    yo++;
+  }
+  if (yo == height)
   {
-    for (int yo = 0; yo < current->extent.height; yo++)
+    return;
+  }
+
+  // The region lies inside the image, so its pixels can be read directly.
+  // Walking down a column steps one row within a tile, or to the tile below
+  // at the bottom of one.
+  assert(x + width <= image->width && y + height <= image->height);
+  int tiled = image->layout == IMAGE_TILED;
+  ptrdiff_t row_step = tiled ? TILE_SIZE * image->nChannels
+                             : image->widthStep;
+  for (int xo = 0; xo < width; xo++)
+  {
+    const uint8_t *pixel = image->pixelsData + image_offset(image, x + xo, y);
+    for (yo = 0; yo < height; yo++)
     {
-      if (get_pixel(image, x + xo, y + yo) != value)
+      if (*pixel != value)
       {
-        region_t *region = region_allocate();
+        region_t *region = list_allocate_region(regions);
         region->depth = current->depth + 1;
         region->position.x = x + xo;
         region->position.y = y + yo;
         find_extent(&(region->extent), image, &(region->position));
-        list_insert_ascending(regions, region);
+        list_append(regions, region);
         find_sub_regions(regions, image, region);
         image_fill_region(image, region, value);
       }
+      if (tiled && ((y + yo + 1) & (TILE_SIZE - 1)) == 0 && yo + 1 < height)
+      {
+        pixel = image->pixelsData + image_offset(image, x + xo, y + yo + 1);
+      }
+      else
+      {
+        pixel += row_step;
+      }
+    }
+  }
+}
+
+// Number of levels a quadtree search can have: enough for any int size.
+enum {QUAD_LEVELS = 32};
+
+// Children of a region found so far that intersect the block searched at one
+// level of a quadtree search.
+typedef struct quad_level
+{
+  region_t **children;
+  int count;
+  int capacity;
+} quad_level_t;
+
+// A quadtree search for the children of region "parent", whose pixels are
+// "value" apart from its children.
+typedef struct quad_search
+{
+  list_t *regions;
+  image_t *image;
+  region_sat_t *sat;
+  const region_t *parent;
+  uint8_t value;
+  quad_level_t levels[QUAD_LEVELS];
+} quad_search_t;
+
+int region_sat_init(region_sat_t *sat, image_t *image)
+{
+  sat->image = image;
+  sat->tiles_x = (image->width + SAT_TILE - 1) / SAT_TILE;
+  sat->tiles_y = (image->height + SAT_TILE - 1) / SAT_TILE;
+  sat->tiles = calloc((size_t) sat->tiles_x * sat->tiles_y,
+                      sizeof(region_sat_tile_t));
+  sat->pixels_read = 0;
+  sat->table_bytes = 0;
+  return sat->tiles != NULL || sat->tiles_x * sat->tiles_y == 0;
+}
+
+void region_sat_free(region_sat_t *sat)
+{
+  if (sat->tiles != NULL)
+  {
+    for (int i = 0; i < sat->tiles_x * sat->tiles_y; i++)
+    {
+      free(sat->tiles[i].sums);
     }
   }
+  free(sat->tiles);
+  sat->tiles = NULL;
+}
+
+// Returns tile (tx, ty) of "sat", reading its pixels first if it has not been
+// built yet.
+static const region_sat_tile_t *sat_tile(region_sat_t *sat, int tx, int ty)
+{
+  region_sat_tile_t *tile = &sat->tiles[ty * sat->tiles_x + tx];
+  if (tile->built)
+  {
+    return tile;
+  }
+
+  image_t *image = sat->image;
+  int x0 = tx * SAT_TILE;
+  int y0 = ty * SAT_TILE;
+  int width = image->width - x0 < SAT_TILE ? image->width - x0 : SAT_TILE;
+  int height = image->height - y0 < SAT_TILE ? image->height - y0 : SAT_TILE;
+  uint8_t pixels[SAT_TILE * SAT_TILE];
+  int uniform = 1;
+  tile->value = image->pixelsData[image_offset(image, x0, y0)];
+  // SAT_TILE is a multiple of TILE_SIZE, so each run of TILE_SIZE pixels of
+  // a row is contiguous in either layout.
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x += TILE_SIZE)
+    {
+      const uint8_t *run = image->pixelsData
+                           + image_offset(image, x0 + x, y0 + y);
+      int length = width - x < TILE_SIZE ? width - x : TILE_SIZE;
+      for (int i = 0; i < length; i++)
+      {
+        uint8_t pixel = run[i * image->nChannels];
+        pixels[y * SAT_TILE + x + i] = pixel;
+        uniform &= pixel == tile->value;
+      }
+    }
+  }
+  sat->pixels_read += (size_t) width * height;
+  tile->built = 1;
+  if (uniform)
+  {
+    uint64_t count = (uint64_t) width * height;
+    tile->sum = tile->value * count;
+    tile->sum_squares = (uint64_t) tile->value * tile->value * count;
+    return tile;
+  }
+
+  // A tile's sums fit in 32 bits: 32 * 32 * 255^2 < 2^32.
+  enum {STRIDE = SAT_TILE + 1, AREA = STRIDE * STRIDE};
+  tile->sums = calloc(2 * AREA, sizeof(uint32_t));
+  if (tile->sums == NULL)
+  {
+    perror("region_sat");
+    exit(EXIT_FAILURE);
+  }
+  sat->table_bytes += 2 * AREA * sizeof(uint32_t);
+  for (int y = 0; y < height; y++)
+  {
+    uint32_t *above = tile->sums + y * STRIDE;
+    uint32_t *above_squares = above + AREA;
+    uint32_t row = 0;
+    uint32_t row_squares = 0;
+    for (int x = 0; x < width; x++)
+    {
+      uint32_t pixel = pixels[y * SAT_TILE + x];
+      row += pixel;
+      row_squares += pixel * pixel;
+      above[STRIDE + x + 1] = above[x + 1] + row;
+      above_squares[STRIDE + x + 1] = above_squares[x + 1] + row_squares;
+    }
+  }
+  tile->sum = tile->sums[height * STRIDE + width];
+  tile->sum_squares = tile->sums[AREA + height * STRIDE + width];
+  return tile;
+}
+
+// Sets "sum" and "squares" to the sums of the pixels of the width x height
+// rectangle at (x, y) and of their squares. Tiles the rectangle covers whole
+// are summed from their totals.
+static void sat_sums(region_sat_t *sat, int x, int y, int width,
+                     int height, uint64_t *sum, uint64_t *squares)
+{
+  enum {STRIDE = SAT_TILE + 1, AREA = STRIDE * STRIDE};
+  *sum = 0;
+  *squares = 0;
+  for (int ty = y / SAT_TILE; ty <= (y + height - 1) / SAT_TILE; ty++)
+  {
+    int top = y - ty * SAT_TILE > 0 ? y - ty * SAT_TILE : 0;
+    int bottom = y + height - ty * SAT_TILE;
+    bottom = bottom < SAT_TILE ? bottom : SAT_TILE;
+    for (int tx = x / SAT_TILE; tx <= (x + width - 1) / SAT_TILE; tx++)
+    {
+      int left = x - tx * SAT_TILE > 0 ? x - tx * SAT_TILE : 0;
+      int right = x + width - tx * SAT_TILE;
+      right = right < SAT_TILE ? right : SAT_TILE;
+      const region_sat_tile_t *tile = sat_tile(sat, tx, ty);
+      if (tile->sums == NULL)
+      {
+        uint64_t count = (uint64_t) (right - left) * (bottom - top);
+        *sum += tile->value * count;
+        *squares += (uint64_t) tile->value * tile->value * count;
+      }
+      else if (left == 0 && top == 0
+               && (right == SAT_TILE || x + width == sat->image->width)
+               && (bottom == SAT_TILE || y + height == sat->image->height))
+      {
+        *sum += tile->sum;
+        *squares += tile->sum_squares;
+      }
+      else
+      {
+        const uint32_t *s = tile->sums;
+        *sum += s[bottom * STRIDE + right] - s[bottom * STRIDE + left]
+                - s[top * STRIDE + right] + s[top * STRIDE + left];
+        s += AREA;
+        *squares += s[bottom * STRIDE + right] - s[bottom * STRIDE + left]
+                    - s[top * STRIDE + right] + s[top * STRIDE + left];
+      }
+    }
+  }
+}
+
+// Returns 1 if "count" pixels whose sum is "sum" and whose sum of squares is
+// "squares" are all "value": the sum of their squared differences from it,
+// squares - 2 * value * sum + value^2 * count, is then 0.
+static int sums_uniform(uint64_t sum, uint64_t squares, uint64_t count,
+                        uint8_t value)
+{
+  return sum == value * count && squares == (uint64_t) value * value * count;
+}
+
+int region_sat_uniform(region_sat_t *sat, int x, int y, int width,
+                       int height, uint8_t value)
+{
+  uint64_t sum;
+  uint64_t squares;
+  sat_sums(sat, x, y, width, height, &sum, &squares);
+  return sums_uniform(sum, squares, (uint64_t) width * height, value);
+}
+
+static void quad_search_region(list_t *regions, image_t *image,
+                               region_sat_t *sat, const region_t *parent);
+
+// Adds "child" to the children known to "level".
+static void quad_level_add(quad_level_t *level, region_t *child)
+{
+  if (level->count == level->capacity)
+  {
+    level->capacity = level->capacity > 0 ? 2 * level->capacity : 16;
+    level->children = realloc(level->children,
+                              level->capacity * sizeof(region_t *));
+    if (level->children == NULL)
+    {
+      perror("find_regions_quadtree");
+      exit(EXIT_FAILURE);
+    }
+  }
+  level->children[level->count++] = child;
+}
+
+// Searches the size x size block at (x, y), clipped to the parent region, at
+// depth "level" of the quadtree. Blocks are visited in Z order, in which the
+// top-left corner of a rectangle comes before all its other pixels, so the
+// first pixel found that is neither the parent's value nor in a known child
+// is the corner of a new child.
+static void quad_search_block(quad_search_t *search, int level, int x, int y,
+                              int size)
+{
+  const region_t *parent = search->parent;
+  int x0 = x > parent->position.x ? x : parent->position.x;
+  int y0 = y > parent->position.y ? y : parent->position.y;
+  int x1 = parent->position.x + parent->extent.width;
+  int y1 = parent->position.y + parent->extent.height;
+  x1 = x + size < x1 ? x + size : x1;
+  y1 = y + size < y1 ? y + size : y1;
+  if (x0 >= x1 || y0 >= y1)
+  {
+    return;
+  }
+
+  // Leave out the pixels of known children: the rest must all be the
+  // parent's value.
+  uint64_t sum;
+  uint64_t squares;
+  uint64_t count = (uint64_t) (x1 - x0) * (y1 - y0);
+  sat_sums(search->sat, x0, y0, x1 - x0, y1 - y0, &sum, &squares);
+  quad_level_t *here = &search->levels[level];
+  here->count = 0;
+  if (level > 0)
+  {
+    const quad_level_t *above = &search->levels[level - 1];
+    for (int i = 0; i < above->count; i++)
+    {
+      region_t *child = above->children[i];
+      int cx0 = child->position.x > x0 ? child->position.x : x0;
+      int cy0 = child->position.y > y0 ? child->position.y : y0;
+      int cx1 = child->position.x + child->extent.width;
+      int cy1 = child->position.y + child->extent.height;
+      cx1 = cx1 < x1 ? cx1 : x1;
+      cy1 = cy1 < y1 ? cy1 : y1;
+      if (cx0 >= cx1 || cy0 >= cy1)
+      {
+        continue;
+      }
+      if (cx0 == x0 && cy0 == y0 && cx1 == x1 && cy1 == y1)
+      {
+        return;
+      }
+      uint64_t child_sum;
+      uint64_t child_squares;
+      sat_sums(search->sat, cx0, cy0, cx1 - cx0, cy1 - cy0, &child_sum,
+               &child_squares);
+      sum -= child_sum;
+      squares -= child_squares;
+      count -= (uint64_t) (cx1 - cx0) * (cy1 - cy0);
+      quad_level_add(here, child);
+    }
+  }
+  if (sums_uniform(sum, squares, count, search->value))
+  {
+    return;
+  }
+
+  if (size > 1)
+  {
+    int half = size / 2;
+    quad_search_block(search, level + 1, x, y, half);
+    quad_search_block(search, level + 1, x + half, y, half);
+    quad_search_block(search, level + 1, x, y + half, half);
+    quad_search_block(search, level + 1, x + half, y + half, half);
+    return;
+  }
+
+  region_t *child = list_allocate_region(search->regions);
+  child->depth = parent->depth + 1;
+  init_point(&child->position, x0, y0);
+  find_extent(&child->extent, search->image, &child->position);
+  list_append(search->regions, child);
+  quad_search_region(search->regions, search->image, search->sat, child);
+  for (int i = 0; i <= level; i++)
+  {
+    quad_level_add(&search->levels[i], child);
+  }
+}
+
+// Finds the children of "parent" in "image" and all their descendants, and
+// appends them to "regions".
+static void quad_search_region(list_t *regions, image_t *image,
+                               region_sat_t *sat, const region_t *parent)
+{
+  quad_search_t search;
+  search.regions = regions;
+  search.image = image;
+  search.sat = sat;
+  search.parent = parent;
+  search.value = get_pixel(image, parent->position.x, parent->position.y);
+  for (int i = 0; i < QUAD_LEVELS; i++)
+  {
+    search.levels[i].children = NULL;
+    search.levels[i].count = 0;
+    search.levels[i].capacity = 0;
+  }
+
+  int size = 1;
+  while (size < parent->extent.width || size < parent->extent.height)
+  {
+    size *= 2;
+  }
+  quad_search_block(&search, 0, parent->position.x, parent->position.y, size);
+
+  for (int i = 0; i < QUAD_LEVELS; i++)
+  {
+    free(search.levels[i].children);
+  }
+}
+
+void find_regions_quadtree(list_t *regions, image_t *image)
+{
+  region_sat_t sat;
+  if (!region_sat_init(&sat, image))
+  {
+    perror("find_regions_quadtree");
+    exit(EXIT_FAILURE);
+  }
+  find_regions_quadtree_sat(regions, &sat);
+  region_sat_free(&sat);
+}
+
+void find_regions_quadtree_sat(list_t *regions, region_sat_t *sat)
+{
+  image_t *image = sat->image;
+  region_t *image_region = list_allocate_region(regions);
+  image_region->depth = 0;
+  init_point(&image_region->position, 0, 0);
+  init_extent(&image_region->extent, image->width, image->height);
+  list_append(regions, image_region);
+  quad_search_region(regions, image, sat, image_region);
+  list_sort(regions);
 }
 
 // Renders all regions to an image using the supplied colour_function_t
@@ -203,4 +704,200 @@ void render_regions(image_t *image, list_t *regions,
     image_fill_region(image, region, get_colour(region));
   }
 }
+
+void region_colour_table(uint8_t *colours, int colour_count,
+                         colour_function_t get_colour)
+{
+  region_t region;
+  init_point(&region.position, 0, 0);
+  init_extent(&region.extent, 0, 0);
+  for (int depth = 0; depth < colour_count; depth++)
+  {
+    region.depth = depth;
+    colours[depth] = get_colour(&region);
+  }
+}
+
+// A region covering the rows being rendered: columns [x0, x1) until row y1.
+typedef struct render_active
+{
+  int x0;
+  int x1;
+  int y1;
+  int depth;
+  uint8_t colour;
+} render_active_t;
+
+// "length" pixels of a row from column "x", in "colour".
+typedef struct render_span
+{
+  int x;
+  int length;
+  uint8_t colour;
+} render_span_t;
+
+// Makes room for "count" elements of "size" bytes in "*array".
+static void render_reserve(void **array, int *capacity, int count,
+                           size_t size)
+{
+  if (count <= *capacity)
+  {
+    return;
+  }
+  *capacity = count > 2 * *capacity ? count : 2 * *capacity;
+  *array = realloc(*array, *capacity * size);
+  if (*array == NULL)
+  {
+    perror("render_regions_spans");
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Adds a span of "colour" over columns [x0, x1) to "spans", if it is not
+// empty.
+static void render_emit(render_span_t **spans, int *count, int *capacity,
+                        int x0, int x1, uint8_t colour)
+{
+  if (x1 > x0)
+  {
+    render_reserve((void **) spans, capacity, *count + 1,
+                   sizeof(render_span_t));
+    (*spans)[*count].x = x0;
+    (*spans)[*count].length = x1 - x0;
+    (*spans)[*count].colour = colour;
+    (*count)++;
+  }
+}
+
+// Splits a row covered by the "count" regions of "active", in order of x0 and
+// then of depth, into spans of the deepest region over each column. Regions
+// that contain one another are open on "stack" at once; each hands the
+// columns up to the next region to the span of the region around it.
+// Returns the number of spans.
+static int render_row_spans(const render_active_t *active, int count,
+                            int *stack, render_span_t **spans,
+                            int *capacity)
+{
+  int span_count = 0;
+  int top = 0;
+  int cursor = 0;
+  for (int i = 0; i <= count; i++)
+  {
+    int x0 = i < count ? active[i].x0 : INT_MAX;
+    while (top > 0 && active[stack[top - 1]].x1 <= x0)
+    {
+      const render_active_t *closed = &active[stack[--top]];
+      render_emit(spans, &span_count, capacity, cursor, closed->x1,
+                  closed->colour);
+      cursor = closed->x1 > cursor ? closed->x1 : cursor;
+    }
+    if (i == count)
+    {
+      break;
+    }
+    if (top > 0)
+    {
+      render_emit(spans, &span_count, capacity, cursor, x0,
+                  active[stack[top - 1]].colour);
+    }
+    cursor = x0 > cursor ? x0 : cursor;
+    stack[top++] = i;
+  }
+  return span_count;
+}
+
+void render_regions_spans(image_t *image, list_t *regions,
+                          const uint8_t *colours, int colour_count)
+{
+  render_active_t *active = NULL;
+  int *stack = NULL;
+  int active_count = 0;
+  int active_capacity = 0;
+  int stack_capacity = 0;
+  render_span_t *spans = NULL;
+  int span_count = 0;
+  int span_capacity = 0;
+  int next_end = INT_MAX;
+  int changed = 0;
+  list_iter next = list_begin(regions);
+  // Rows of single-channel row-major images are filled in place.
+  int direct = image->layout == IMAGE_ROW_MAJOR && image->nChannels == 1;
+
+  for (int y = 0; y < image->height; y++)
+  {
+    // Regions are in the order of region_compare(), so those starting on this
+    // row are next in the list. Each is kept in order of x0 and depth.
+    for (; next != list_end(regions) && list_iter_value(next)->position.y <= y;
+         next = list_iter_next(next))
+    {
+      const region_t *region = list_iter_value(next);
+      render_reserve((void **) &active, &active_capacity, active_count + 1,
+                     sizeof(render_active_t));
+      int i = active_count++;
+      while (i > 0 && (active[i - 1].x0 > region->position.x
+                       || (active[i - 1].x0 == region->position.x
+                           && active[i - 1].depth > region->depth)))
+      {
+        active[i] = active[i - 1];
+        i--;
+      }
+      active[i].x0 = region->position.x;
+      active[i].x1 = region->position.x + region->extent.width;
+      active[i].y1 = region->position.y + region->extent.height;
+      active[i].depth = region->depth;
+      active[i].colour = colours[region->depth % colour_count];
+      next_end = active[i].y1 < next_end ? active[i].y1 : next_end;
+      changed = 1;
+    }
+    if (y >= next_end)
+    {
+      int kept = 0;
+      next_end = INT_MAX;
+      for (int i = 0; i < active_count; i++)
+      {
+        if (active[i].y1 > y)
+        {
+          next_end = active[i].y1 < next_end ? active[i].y1 : next_end;
+          active[kept++] = active[i];
+        }
+      }
+      active_count = kept;
+      changed = 1;
+    }
+    if (active_count == 0 && next == list_end(regions))
+    {
+      break;
+    }
+
+    // Rows between the starts and ends of regions are covered alike, so
+    // their spans are found once and repeated.
+    if (changed)
+    {
+      render_reserve((void **) &stack, &stack_capacity, active_count,
+                     sizeof(int));
+      span_count = render_row_spans(active, active_count, stack, &spans,
+                                    &span_capacity);
+      changed = 0;
+    }
+    if (direct)
+    {
+      uint8_t *row = image_row(image, y);
+      for (int i = 0; i < span_count; i++)
+      {
+        memset(row + spans[i].x, spans[i].colour, spans[i].length);
+      }
+    }
+    else
+    {
+      for (int i = 0; i < span_count; i++)
+      {
+        image_fill_span(image, spans[i].x, y, spans[i].length,
+                        spans[i].colour);
+      }
+    }
+  }
+  free(active);
+  free(stack);
+  free(spans);
+}
 ///////////////////////////////////////////////////////////////////////////////
@@ -74,15 +74,94 @@ void image_fill_region(image_t *image, const region_t *region, uint8_t value);
 // extent: this will be populated with the width and height of a region.
 void find_extent(extent_t *extent, image_t *image, const point_t *position);
 
+// As image_fill_region() and find_extent(), but for a region of a view into an
+// image, with positions relative to the view. Lets sub-rectangles of an image
+// be processed without copying them.
+void image_view_fill_region(const image_view_t *view, const region_t *region,
+                            uint8_t value);
+void find_extent_in_view(extent_t *extent, const image_view_t *view,
+                         const point_t *position);
+
 // Finds all regions located in the region "current" of "image" and adds them
-// to "regions".  Regions are added so that ordering according to the
-// comparison function region_compare() is preserved.
+// to the end of "regions", in the order they are found. Sort the list with
+// list_sort() afterwards to order it by region_compare().
 void find_sub_regions(list_t *regions, image_t *image,
                       const region_t *current);
 
+// Side of the square tiles a region_sat_t is built in.
+enum {SAT_TILE = 32};
+
+// One tile of a region_sat_t. "sums" is NULL until the tile is built, and
+// stays NULL if all its pixels are "value"; otherwise entry y * (SAT_TILE + 1)
+// + x of "sums" is the sum of the pixels of the tile above and to the left of
+// (x, y), and the same entry of the second half the sum of their squares.
+typedef struct region_sat_tile
+{
+  uint32_t *sums;
+  uint64_t sum;
+  uint64_t sum_squares;
+  int built;
+  uint8_t value;
+} region_sat_tile_t;
+
+// A summed-area table of the first channel of an image, built lazily a tile
+// at a time, the first time a query covers the tile. A uniform tile keeps only
+// its value; any other takes 8 bytes per pixel. "pixels_read" counts the
+// pixels read so far and "table_bytes" the bytes taken by tile tables.
+typedef struct region_sat
+{
+  image_t *image;
+  int tiles_x;
+  int tiles_y;
+  region_sat_tile_t *tiles;
+  size_t pixels_read;
+  size_t table_bytes;
+} region_sat_t;
+
+// Prepares a summed-area table of "image", without reading any pixels yet.
+// Returns 0 if memory ran out.
+int region_sat_init(region_sat_t *sat, image_t *image);
+
+// Deallocates the tiles of "sat".
+void region_sat_free(region_sat_t *sat);
+
+// Returns 1 if every pixel of the width x height rectangle at (x, y) is
+// "value", building the tiles it covers that have not been built yet.
+int region_sat_uniform(region_sat_t *sat, int x, int y, int width,
+                       int height, uint8_t value);
+
+// As find_regions(), but without modifying "image": each region is searched
+// for children with a quadtree over the summed-area table of the image, which
+// skips blocks that are uniform apart from children already found. Every
+// pixel is read once, when its tile of the table is built.
+void find_regions_quadtree(list_t *regions, image_t *image);
+
+// As find_regions_quadtree(), on the image of "sat", whose counters are left
+// for the caller to read.
+void find_regions_quadtree_sat(list_t *regions, region_sat_t *sat);
+
 // Renders all regions to an image using colour_function_t
 //(declared in region.h) to select pixel intensity.
 void render_regions(image_t *image, list_t *regions,
                     colour_function_t get_colour);
+
+// Number of depths after which the colours of region_colour() repeat.
+enum {REGION_COLOURS = 255};
+
+// Fills "colours" with the colour that "get_colour" gives a region of each
+// depth from 0 to colour_count - 1.
+void region_colour_table(uint8_t *colours, int colour_count,
+                         colour_function_t get_colour);
+
+// As render_regions(), for regions in the order of region_compare() that
+// contain one another or are apart, as find_regions() produces, but writes
+// each pixel once. Rows are swept top to bottom, keeping the regions that
+// cover the row in order of column and depth, and each row is filled with a
+// span per run of pixels of the same deepest region. A region of depth d has
+// colour colours[d % colour_count]. Painting whole rectangles with memset()
+// is as fast at the image sizes measured by bench_regions, so render_regions()
+// remains the renderer of main and batch mode.
+void render_regions_spans(image_t *image, list_t *regions,
+                          const uint8_t *colours, int colour_count);
 //////////////////////////////////////////////////////////////////////////////
 #endif
@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "region_file.h"
+#include "list.h"
+#include "typedefs.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Number of columns of a region file.
+enum {COLUMNS = 5};
+
+static const char magic[4] = {'R', 'G', 'N', 'S'};
+
+static void put_le32(uint8_t *out, uint32_t value)
+{
+  out[0] = value & 0xff;
+  out[1] = (value >> 8) & 0xff;
+  out[2] = (value >> 16) & 0xff;
+  out[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t get_le32(const uint8_t *in)
+{
+  return in[0] | (uint32_t) in[1] << 8 | (uint32_t) in[2] << 16
+         | (uint32_t) in[3] << 24;
+}
+
+// Returns 1 if this machine stores numbers little-endian, as region files do.
+static int little_endian(void)
+{
+  const uint16_t probe = 1;
+  return *(const uint8_t *) &probe == 1;
+}
+
+// Writes all "size" bytes of "data" to "fd" at "offset". Returns 0 on
+// failure.
+static int write_at(int fd, const uint8_t *data, size_t size, off_t offset)
+{
+  while (size > 0)
+  {
+    ssize_t written = pwrite(fd, data, size, offset);
+    if (written < 0)
+    {
+      return 0;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return 1;
+}
+
+int region_file_write(const char *path, list_t *regions)
+{
+  size_t count = 0;
+  for (list_iter i = list_begin(regions); i != list_end(regions);
+       i = list_iter_next(i))
+  {
+    count++;
+  }
+
+  // Every column's place in the file is known from the count, so a chunk of
+  // each column is filled from the list and written to its place in turn.
+  uint8_t *buffer = malloc((size_t) COLUMNS * REGION_FILE_CHUNK * 4);
+  if (buffer == NULL)
+  {
+    perror("region_file_write");
+    exit(EXIT_FAILURE);
+  }
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  int ok = fd >= 0;
+
+  uint8_t header[REGION_FILE_HEADER];
+  memcpy(header, magic, sizeof(magic));
+  put_le32(header + 4, REGION_FILE_VERSION);
+  put_le32(header + 8, (uint32_t) count);
+  put_le32(header + 12, (uint32_t) ((uint64_t) count >> 32));
+  ok = ok && write_at(fd, header, sizeof(header), 0);
+
+  int host_order = little_endian();
+  size_t written = 0;
+  size_t filled = 0;
+  list_iter i = list_begin(regions);
+  while (ok && written < count)
+  {
+    const region_t *region = list_iter_value(i);
+    const int32_t values[COLUMNS] = {region->position.x, region->position.y,
+                                     region->extent.width,
+                                     region->extent.height, region->depth};
+    for (int c = 0; c < COLUMNS; c++)
+    {
+      uint8_t *out = buffer + ((size_t) c * REGION_FILE_CHUNK + filled) * 4;
+      if (host_order)
+      {
+        memcpy(out, &values[c], 4);
+      }
+      else
+      {
+        put_le32(out, (uint32_t) values[c]);
+      }
+    }
+    filled++;
+    i = list_iter_next(i);
+    if (filled == REGION_FILE_CHUNK || written + filled == count)
+    {
+      for (int c = 0; ok && c < COLUMNS; c++)
+      {
+        ok = write_at(fd, buffer + (size_t) c * REGION_FILE_CHUNK * 4,
+                      filled * 4,
+                      REGION_FILE_HEADER + ((off_t) c * count + written) * 4);
+      }
+      written += filled;
+      filled = 0;
+    }
+  }
+
+  if (fd >= 0 && close(fd) != 0)
+  {
+    ok = 0;
+  }
+  if (!ok)
+  {
+    perror(path);
+  }
+  free(buffer);
+  return ok;
+}
+
+int region_file_open(region_file_t *file, const char *path)
+{
+  file->map = NULL;
+  file->size = 0;
+  file->count = 0;
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    perror(path);
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    return 0;
+  }
+
+  // On a big-endian machine the mapping is private and writable, so that
+  // the columns can be put into host order in place.
+  int swap = !little_endian();
+  size_t size = st.st_size;
+  void *map = size > 0 ? mmap(NULL, size,
+                              swap ? PROT_READ | PROT_WRITE : PROT_READ,
+                              MAP_PRIVATE, fd, 0)
+                       : MAP_FAILED;
+  close(fd);
+  if (size > 0 && map == MAP_FAILED)
+  {
+    perror(path);
+    return 0;
+  }
+
+  const uint8_t *bytes = map;
+  uint64_t count = 0;
+  int ok = size >= REGION_FILE_HEADER
+           && memcmp(bytes, magic, sizeof(magic)) == 0
+           && get_le32(bytes + 4) == REGION_FILE_VERSION;
+  if (ok)
+  {
+    count = get_le32(bytes + 8) | (uint64_t) get_le32(bytes + 12) << 32;
+    ok = count <= (size - REGION_FILE_HEADER) / (COLUMNS * 4)
+         && size == REGION_FILE_HEADER + count * COLUMNS * 4;
+  }
+  if (!ok)
+  {
+    fprintf(stderr, "%s: not a region file\n", path);
+    if (map != MAP_FAILED)
+    {
+      munmap(map, size);
+    }
+    return 0;
+  }
+
+  int32_t *columns = (int32_t *) (bytes + REGION_FILE_HEADER);
+  if (swap)
+  {
+    for (size_t i = 0; i < count * COLUMNS; i++)
+    {
+      columns[i] = (int32_t) get_le32((const uint8_t *) &columns[i]);
+    }
+  }
+  file->map = map;
+  file->size = size;
+  file->count = count;
+  file->x = columns;
+  file->y = columns + count;
+  file->width = columns + 2 * count;
+  file->height = columns + 3 * count;
+  file->depth = columns + 4 * count;
+  return 1;
+}
+
+void region_file_get(const region_file_t *file, size_t i, region_t *region)
+{
+  region->position.x = file->x[i];
+  region->position.y = file->y[i];
+  region->extent.width = file->width[i];
+  region->extent.height = file->height[i];
+  region->depth = file->depth[i];
+}
+
+void region_file_close(region_file_t *file)
+{
+  if (file->map != NULL)
+  {
+    munmap(file->map, file->size);
+  }
+  file->map = NULL;
+  file->size = 0;
+  file->count = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef _REGION_FILE_H_
+#define _REGION_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "typedefs.h"
+
+// A region file stores regions by column. A header of REGION_FILE_HEADER
+// bytes, the magic "RGNS", a uint32 version and a uint64 region count, is
+// followed by the x, y, width, height and depth of every region, one array
+// after the other, as int32 values. All numbers are little-endian.
+enum {REGION_FILE_HEADER = 16, REGION_FILE_VERSION = 1};
+
+// Number of regions buffered per column while a file is written.
+enum {REGION_FILE_CHUNK = 16384};
+
+// A region file mapped into memory. The columns point into the mapping and
+// hold "count" values each, in host byte order.
+typedef struct region_file
+{
+  void *map;
+  size_t size;
+  size_t count;
+  const int32_t *x;
+  const int32_t *y;
+  const int32_t *width;
+  const int32_t *height;
+  const int32_t *depth;
+} region_file_t;
+
+// Writes "regions" to region file "path" in one pass over the list, filling a
+// chunk of each column at a time. Returns 0 on failure, which is reported on
+// stderr.
+int region_file_write(const char *path, list_t *regions);
+
+// Maps region file "path" into "file", so that its columns can be read
+// without parsing. Returns 0 on failure, which is reported on stderr.
+int region_file_open(region_file_t *file, const char *path);
+
+// Stores region "i" of "file" in "region".
+void region_file_get(const region_file_t *file, size_t i, region_t *region);
+
+// Unmaps "file".
+void region_file_close(region_file_t *file);
+
+#endif
@@ -0,0 +1,746 @@
+#include "scanline.h"
+#include "image.h"
+#include "region.h"
+#include "list.h"
+#include "tree.h"
+#include "typedefs.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Index of no open rectangle.
+enum {NONE = -1};
+
+// Number of rows read at a time by the sequential detector.
+enum {BAND_ROWS = 256};
+
+// Position in the runs of a row. Lookups must move left to right.
+typedef struct run_cursor
+{
+  const image_run_t *runs;
+  int count;
+  int index;
+} run_cursor_t;
+
+// A region that is open in the current row: it started on this row or an
+// earlier one, and its left column has kept its value so far. Open children
+// are kept in x order in a list threaded through "next".
+typedef struct open_rect
+{
+  region_t *region;
+  int parent;
+  int x1;            // end of the region's span in the row, within its parent
+  uint8_t value;
+  int open;
+  int first_child;
+  int next;
+} open_rect_t;
+
+// Progress through the span of open rectangle "node" in the current row:
+// pixels before "x" have been scanned, "child" is the next open child to
+// reach and "prev" is the child before it.
+typedef struct scan_frame
+{
+  int node;
+  int x;
+  int prev;
+  int child;
+} scan_frame_t;
+
+// The state of a sweep. Rectangles are referred to by index, since "rects"
+// moves as it grows; the frames form an explicit stack, one per level of
+// nesting at the current x. A sweep that starts at row "first_row" of
+// "image", rather than at its top, finds the rectangles there again.
+typedef struct scanner
+{
+  list_t *regions;
+  region_tree_t *tree;
+  image_t *image;
+  int first_row;
+  open_rect_t *rects;
+  int count;
+  int capacity;
+  scan_frame_t *stack;
+  int depth;
+  int stack_capacity;
+} scanner_t;
+
+// A band of rows of the image, whose regions are found on a thread of its
+// own as if the band were an image of its own inside the image region. The
+// band's regions are allocated from its own arena; "merged" gives the region
+// of the whole image that each of its rectangles is part of. The first
+// "inherited" rectangles of its sweep are those of the image, not the band.
+typedef struct band
+{
+  image_t *image;
+  int y0;
+  int y1;
+  region_arena_t arena;
+  list_t regions;
+  scanner_t scanner;
+  int inherited;
+  region_t **merged;
+  pthread_t thread;
+  int threaded;
+} band_t;
+
+// Makes room for one more element in "array", which holds "count" elements
+// of "size" bytes and has room for "*capacity".
+static void *grow(void *array, int count, int *capacity, size_t size)
+{
+  if (count < *capacity)
+  {
+    return array;
+  }
+  *capacity = *capacity > 0 ? 2 * *capacity : 64;
+  array = realloc(array, *capacity * size);
+  if (array == NULL)
+  {
+    perror("scanline_find_regions");
+    exit(EXIT_FAILURE);
+  }
+  return array;
+}
+
+// Opens a rectangle for "region", inside rectangle "parent", with pixel value
+// "value" and a span in the current row that ends at x1, and returns its
+// index.
+static int open_rect(scanner_t *scanner, region_t *region, int parent, int x1,
+                     uint8_t value)
+{
+  scanner->rects = grow(scanner->rects, scanner->count, &scanner->capacity,
+                        sizeof(open_rect_t));
+  open_rect_t *rect = &scanner->rects[scanner->count];
+  rect->region = region;
+  rect->parent = parent;
+  rect->x1 = x1;
+  rect->value = value;
+  rect->open = 1;
+  rect->first_child = NONE;
+  rect->next = NONE;
+  return scanner->count++;
+}
+
+// Pushes a frame for scanning the span of rectangle "node" from its start.
+static void push_frame(scanner_t *scanner, int node)
+{
+  scanner->stack = grow(scanner->stack, scanner->depth,
+                        &scanner->stack_capacity, sizeof(scan_frame_t));
+  scan_frame_t *frame = &scanner->stack[scanner->depth++];
+  frame->node = node;
+  frame->x = scanner->rects[node].region->position.x;
+  frame->prev = NONE;
+  frame->child = scanner->rects[node].first_child;
+}
+
+// Makes "rect" follow "prev" among the children of "node".
+static void link_after(scanner_t *scanner, int node, int prev, int rect)
+{
+  if (prev == NONE)
+  {
+    scanner->rects[node].first_child = rect;
+  }
+  else
+  {
+    scanner->rects[prev].next = rect;
+  }
+}
+
+// Closes child "rect" of "node", which follows "prev", at row y: its height
+// is now known. Any children it still has take its place among the children
+// of "node". Returns the child that now follows "prev".
+static int close_rect(scanner_t *scanner, int node, int prev, int rect, int y)
+{
+  open_rect_t *closed = &scanner->rects[rect];
+  closed->open = 0;
+  closed->region->extent.height = y - closed->region->position.y;
+  int following = closed->first_child;
+  if (following == NONE)
+  {
+    following = closed->next;
+  }
+  else
+  {
+    int last = following;
+    while (scanner->rects[last].next != NONE)
+    {
+      last = scanner->rects[last].next;
+    }
+    scanner->rects[last].next = closed->next;
+  }
+  link_after(scanner, node, prev, following);
+  return following;
+}
+
+// Returns the end of run i of "cursor".
+static int run_end(const run_cursor_t *cursor, int i)
+{
+  return cursor->runs[i].start + cursor->runs[i].length;
+}
+
+// Moves "cursor" to the run containing x.
+static void run_seek(run_cursor_t *cursor, int x)
+{
+  while (run_end(cursor, cursor->index) <= x)
+  {
+    cursor->index++;
+  }
+}
+
+// Returns the value at x, without moving "cursor": the pixels before x may
+// still have to be scanned.
+static uint8_t run_value(const run_cursor_t *cursor, int x)
+{
+  int i = cursor->index;
+  while (run_end(cursor, i) <= x)
+  {
+    i++;
+  }
+  return cursor->runs[i].value;
+}
+
+// Returns the first position in [x, limit) whose value is not "value", or
+// limit if there is none.
+static int run_find_difference(run_cursor_t *cursor, int x, int limit,
+                               uint8_t value)
+{
+  run_seek(cursor, x);
+  while (cursor->runs[cursor->index].value == value)
+  {
+    if (run_end(cursor, cursor->index) >= limit)
+    {
+      return limit;
+    }
+    cursor->index++;
+  }
+  int start = cursor->runs[cursor->index].start;
+  return start > x ? start : x;
+}
+
+// Returns the width of the region found at (x, y), in the first row of a
+// sweep that starts there. If its left column has its value in the rows
+// above, the region started in the first of them, and its width is that of
+// its run there, as the sweep from the top of the image would have found.
+static int first_row_width(const scanner_t *scanner,
+                           const run_cursor_t *cursor, int x, int y)
+{
+  uint8_t value = cursor->runs[cursor->index].value;
+  int top = y;
+  while (top > 0 && get_pixel(scanner->image, x, top - 1) == value)
+  {
+    top--;
+  }
+  if (top == y)
+  {
+    return run_end(cursor, cursor->index) - x;
+  }
+  image_runs_t runs;
+  image_runs_init(&runs);
+  image_error_t res = image_runs_read(&runs, scanner->image, top, 1);
+  if (res != IMG_OK)
+  {
+    image_print_error(res);
+    exit(EXIT_FAILURE);
+  }
+  run_cursor_t above = {runs.runs, runs.count[0], 0};
+  run_seek(&above, x);
+  int width = run_end(&above, above.index) - x;
+  image_runs_free(&runs);
+  return width;
+}
+
+// Sweeps row y, whose runs are in "cursor", through the open rectangles:
+// closes those whose left column no longer has their value and opens a region
+// wherever a pixel differs from the innermost open rectangle around it.
+static void scan_row(scanner_t *scanner, run_cursor_t *cursor, int y)
+{
+  scanner->depth = 0;
+  push_frame(scanner, 0);
+  while (scanner->depth > 0)
+  {
+    scan_frame_t *frame = &scanner->stack[scanner->depth - 1];
+    int node = frame->node;
+
+    while (frame->child != NONE
+           && run_value(cursor, scanner->rects[frame->child].region->position.x)
+              != scanner->rects[frame->child].value)
+    {
+      frame->child = close_rect(scanner, node, frame->prev, frame->child, y);
+    }
+
+    int limit = frame->child != NONE
+                ? scanner->rects[frame->child].region->position.x
+                : scanner->rects[node].x1;
+    uint8_t value = scanner->rects[node].value;
+    while (frame->x < limit)
+    {
+      frame->x = run_find_difference(cursor, frame->x, limit, value);
+      if (frame->x == limit)
+      {
+        break;
+      }
+
+      // A new region: its width is the run of its value, as in find_extent().
+      int x = frame->x;
+      region_t *region = list_allocate_region(scanner->regions);
+      region->depth = scanner->rects[node].region->depth + 1;
+      region->position.x = x;
+      region->position.y = y;
+      region->extent.width = y == scanner->first_row
+                             ? first_row_width(scanner, cursor, x, y)
+                             : run_end(cursor, cursor->index) - x;
+      region->extent.height = 0;
+      list_append(scanner->regions, region);
+
+      int x1 = x + region->extent.width < limit ? x + region->extent.width
+                                                : limit;
+      int rect = open_rect(scanner, region, node, x1,
+                           cursor->runs[cursor->index].value);
+      scanner->rects[rect].next = frame->child;
+      link_after(scanner, node, frame->prev, rect);
+      if (x1 > run_end(cursor, cursor->index))
+      {
+        // Found again in the first row, past its run: scan it as a child.
+        frame->child = rect;
+        break;
+      }
+      frame->prev = rect;
+      frame->x = x1;
+    }
+
+    if (frame->child == NONE)
+    {
+      scanner->depth--;
+      continue;
+    }
+    int child = frame->child;
+    frame->x = scanner->rects[child].x1;
+    frame->prev = child;
+    frame->child = scanner->rects[child].next;
+    push_frame(scanner, child);
+  }
+}
+
+// Sweeps the rows of "runs" through the open rectangles of "scanner".
+// Nothing opens or closes in a row equal to the one above, so rows that share
+// the runs above them are skipped.
+static void scan_runs(scanner_t *scanner, const image_runs_t *runs)
+{
+  for (int i = 0; i < runs->height; i++)
+  {
+    if (i > 0 && runs->first[i] == runs->first[i - 1])
+    {
+      continue;
+    }
+    run_cursor_t cursor = {runs->runs + runs->first[i], runs->count[i], 0};
+    scan_row(scanner, &cursor, runs->y0 + i);
+  }
+}
+
+// Sweeps rows [y0, y1) of "image" through the open rectangles of "scanner",
+// reading them into runs a band of BAND_ROWS at a time.
+static void scan_rows(scanner_t *scanner, image_t *image, int y0, int y1)
+{
+  image_runs_t runs;
+  image_runs_init(&runs);
+  for (int y = y0; y < y1; y += BAND_ROWS)
+  {
+    image_error_t res = image_runs_read(&runs, image, y,
+                                        y1 - y < BAND_ROWS ? y1 - y
+                                                           : BAND_ROWS);
+    if (res != IMG_OK)
+    {
+      image_print_error(res);
+      exit(EXIT_FAILURE);
+    }
+    scan_runs(scanner, &runs);
+  }
+  image_runs_free(&runs);
+}
+
+// Starts "scanner" on an image of size "width" x "height" whose first pixel
+// is "value", adding the region of the whole image to "regions". If "tree" is
+// not NULL, the containment tree of the regions is built in it when the scan
+// finishes.
+static void scanner_init(scanner_t *scanner, list_t *regions,
+                         region_tree_t *tree, int width, int height,
+                         uint8_t value)
+{
+  scanner->regions = regions;
+  scanner->tree = tree;
+  scanner->image = NULL;
+  scanner->first_row = -1;
+  scanner->rects = NULL;
+  scanner->count = 0;
+  scanner->capacity = 0;
+  scanner->stack = NULL;
+  scanner->depth = 0;
+  scanner->stack_capacity = 0;
+
+  region_t *image_region = list_allocate_region(regions);
+  image_region->depth = 0;
+  init_point(&image_region->position, 0, 0);
+  init_extent(&image_region->extent, width, height);
+  list_append(regions, image_region);
+  open_rect(scanner, image_region, NONE, width, value);
+}
+
+// Sets the height of the regions still open in "scanner": they reach row
+// "height".
+static void scanner_close(scanner_t *scanner, int height)
+{
+  for (int i = 1; i < scanner->count; i++)
+  {
+    if (scanner->rects[i].open)
+    {
+      region_t *region = scanner->rects[i].region;
+      region->extent.height = height - region->position.y;
+    }
+  }
+}
+
+// Finishes "scanner" on an image "height" rows high: regions still open
+// reach its bottom.
+static void scanner_finish(scanner_t *scanner, int height)
+{
+  scanner_close(scanner, height);
+
+  // Rectangles were opened in the order of region_compare(), and each one
+  // knows the rectangle it was opened in.
+  if (scanner->tree != NULL)
+  {
+    region_t **regions = malloc(scanner->count * sizeof(region_t *));
+    int *parents = malloc(scanner->count * sizeof(int));
+    if (regions == NULL || parents == NULL)
+    {
+      perror("scanline_find_regions");
+      exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < scanner->count; i++)
+    {
+      regions[i] = scanner->rects[i].region;
+      parents[i] = scanner->rects[i].parent;
+    }
+    if (!region_tree_init(scanner->tree, regions, parents, scanner->count))
+    {
+      perror("scanline_find_regions");
+      exit(EXIT_FAILURE);
+    }
+    free(regions);
+    free(parents);
+  }
+  free(scanner->rects);
+  free(scanner->stack);
+}
+
+// Finds the regions of "image" a band of rows at a time, and their tree if
+// "tree" is not NULL.
+static void scan_sequential(list_t *regions, region_tree_t *tree,
+                            image_t *image)
+{
+  scanner_t scanner;
+  scanner_init(&scanner, regions, tree, image->width, image->height,
+               get_pixel(image, 0, 0));
+  scan_rows(&scanner, image, 0, image->height);
+  scanner_finish(&scanner, image->height);
+}
+
+void scanline_find_regions(list_t *regions, image_t *image)
+{
+  scan_sequential(regions, NULL, image);
+}
+
+void scanline_find_region_tree(region_tree_t *tree, list_t *regions,
+                               image_t *image)
+{
+  scan_sequential(regions, tree, image);
+}
+
+void scanline_find_regions_stream(list_t *regions, image_stream_t *stream)
+{
+  image_runs_t runs;
+  image_runs_init(&runs);
+  // The value of the image region is only known once a band has been read.
+  int count;
+  image_error_t res = image_runs_read_stream(&runs, stream, &count);
+  if (res == IMG_OK && count > 0)
+  {
+    scanner_t scanner;
+    scanner_init(&scanner, regions, NULL, stream->width, stream->height,
+                 stream->buffer[0]);
+    while (res == IMG_OK && count > 0)
+    {
+      scan_runs(&scanner, &runs);
+      res = image_runs_read_stream(&runs, stream, &count);
+    }
+    scanner_finish(&scanner, stream->height);
+  }
+  image_runs_free(&runs);
+  if (res != IMG_OK)
+  {
+    image_print_error(res);
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Finds the regions of "arg", a band_t, in rows of its own. The band is
+// swept as an image whose image region has the value of the whole image's, so
+// rectangles that continue from the band above are found again in its first
+// row; merge_band() joins them up.
+static void *band_scan(void *arg)
+{
+  band_t *band = arg;
+  scanner_init(&band->scanner, &band->regions, NULL, band->image->width,
+               band->y1, get_pixel(band->image, 0, 0));
+  band->scanner.image = band->image;
+  band->scanner.first_row = band->y0;
+  band->inherited = 1;
+  scan_rows(&band->scanner, band->image, band->y0, band->y1);
+  scanner_close(&band->scanner, band->y1);
+  return NULL;
+}
+
+// Records in "open_at" and "parent_at" the rectangles of "band" that are
+// still open at its bottom row, by their left column, and the open rectangle
+// each one is in; or, if "clear" is set, removes them.
+static void mark_open(int *open_at, int *parent_at, const band_t *band,
+                      int clear)
+{
+  const open_rect_t *rects = band->scanner.rects;
+  for (int i = 0; i < band->scanner.count; i++)
+  {
+    if (i > 0 && !rects[i].open)
+    {
+      continue;
+    }
+    for (int child = rects[i].first_child; child != NONE;
+         child = rects[child].next)
+    {
+      int x = rects[child].region->position.x;
+      open_at[x] = clear ? NONE : child;
+      parent_at[x] = clear ? NONE : i;
+    }
+  }
+}
+
+// Returns whether the rectangles "band" found in its first row are those
+// that a sweep continuing from the bottom of "above" would have open there,
+// and sets "match" to the rectangle of "above" that each of them continues,
+// or NONE. This holds for any image of nested rectangles. Otherwise a
+// rectangle's span, fixed in its first row, or the rectangle it is in may
+// not be what the band's first row alone shows.
+static int band_matches(const band_t *band, const band_t *above,
+                        const int *open_at, const int *parent_at, int *match)
+{
+  const scanner_t *scanner = &band->scanner;
+  const scanner_t *prev = &above->scanner;
+
+  // Rectangles of "above" whose left column keeps its value stay open.
+  int survivors = 0;
+  for (int j = 1; j < prev->count; j++)
+  {
+    const open_rect_t *rect = &prev->rects[j];
+    if (rect->open && get_pixel(band->image, rect->region->position.x,
+                                band->y0) == rect->value)
+    {
+      survivors++;
+    }
+  }
+
+  int matched = 0;
+  match[0] = 0;
+  for (int i = 1; i < scanner->count; i++)
+  {
+    const open_rect_t *rect = &scanner->rects[i];
+    int x = rect->region->position.x;
+    int j = rect->region->position.y == band->y0 ? open_at[x] : NONE;
+    match[i] = NONE;
+    if (j == NONE || prev->rects[j].value != rect->value)
+    {
+      continue;
+    }
+    if (prev->rects[j].x1 != rect->x1
+        || prev->rects[j].region->depth != rect->region->depth
+        || parent_at[x] != match[rect->parent])
+    {
+      return 0;
+    }
+    match[i] = j;
+    matched++;
+  }
+  return matched == survivors;
+}
+
+// Sweeps "band" again on the calling thread, continuing from the rectangles
+// of "above", which refer to the regions of the whole image.
+static void band_rescan(band_t *band, const band_t *above)
+{
+  free(band->scanner.rects);
+  free(band->scanner.stack);
+  list_destroy(&band->regions);
+  region_arena_init(&band->arena);
+  list_init_arena(&band->regions, &band->arena);
+
+  scanner_t *scanner = &band->scanner;
+  scanner->first_row = -1;
+  scanner->count = above->scanner.count;
+  scanner->capacity = above->scanner.count;
+  scanner->rects = malloc(scanner->capacity * sizeof(open_rect_t));
+  if (scanner->rects == NULL)
+  {
+    perror("scanline_find_regions_parallel");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < scanner->count; i++)
+  {
+    scanner->rects[i] = above->scanner.rects[i];
+    scanner->rects[i].region = above->merged[i];
+  }
+  scanner->stack = NULL;
+  scanner->depth = 0;
+  scanner->stack_capacity = 0;
+  band->inherited = scanner->count;
+  scan_rows(scanner, band->image, band->y0, band->y1);
+  scanner_close(scanner, band->y1);
+}
+
+// Adds the regions of "band" to "regions", where "image_region" is the region
+// of the whole image. A rectangle that continues one of the band above,
+// "above", as given by "match", only extends its region, and so do inherited
+// rectangles, whose regions were already extended by the sweep. Other
+// rectangles are new regions, appended in the order they were opened, which
+// is the order of region_compare(): every region of "band" starts below those
+// of the bands above it.
+static void merge_band(list_t *regions, region_t *image_region, band_t *band,
+                       const band_t *above, const int *match)
+{
+  const scanner_t *scanner = &band->scanner;
+  band->merged = malloc(scanner->count * sizeof(region_t *));
+  if (band->merged == NULL)
+  {
+    perror("scanline_find_regions_parallel");
+    exit(EXIT_FAILURE);
+  }
+  band->merged[0] = image_region;
+  for (int i = 1; i < scanner->count; i++)
+  {
+    region_t *found = scanner->rects[i].region;
+    if (i < band->inherited)
+    {
+      band->merged[i] = found;
+    }
+    else if (match != NULL && match[i] != NONE)
+    {
+      region_t *region = above->merged[match[i]];
+      region->extent.height = found->position.y + found->extent.height
+                              - region->position.y;
+      band->merged[i] = region;
+    }
+    else
+    {
+      region_t *region = list_allocate_region(regions);
+      *region = *found;
+      list_append(regions, region);
+      band->merged[i] = region;
+    }
+  }
+}
+
+// Releases what "band" holds once it has been merged.
+static void band_free(band_t *band)
+{
+  free(band->merged);
+  free(band->scanner.rects);
+  free(band->scanner.stack);
+  list_destroy(&band->regions);
+}
+
+void scanline_find_regions_parallel(list_t *regions, image_t *image,
+                                    int threads)
+{
+  if (threads > image->height)
+  {
+    threads = image->height;
+  }
+  if (threads <= 1)
+  {
+    scanline_find_regions(regions, image);
+    return;
+  }
+
+  // Bands are swept concurrently, and merged in order as each one finishes.
+  // Open rectangles have distinct left columns, so "open_at" can map a
+  // column to the rectangle of the band above that is open there.
+  band_t *bands = malloc(threads * sizeof(band_t));
+  int *open_at = malloc(2 * image->width * sizeof(int));
+  if (bands == NULL || open_at == NULL)
+  {
+    perror("scanline_find_regions_parallel");
+    exit(EXIT_FAILURE);
+  }
+  int *parent_at = open_at + image->width;
+  for (int x = 0; x < 2 * image->width; x++)
+  {
+    open_at[x] = NONE;
+  }
+  for (int i = 0; i < threads; i++)
+  {
+    band_t *band = &bands[i];
+    band->image = image;
+    band->y0 = (int) ((long) image->height * i / threads);
+    band->y1 = (int) ((long) image->height * (i + 1) / threads);
+    region_arena_init(&band->arena);
+    list_init_arena(&band->regions, &band->arena);
+    band->merged = NULL;
+    band->threaded = pthread_create(&band->thread, NULL, band_scan, band) == 0;
+  }
+
+  region_t *image_region = list_allocate_region(regions);
+  image_region->depth = 0;
+  init_point(&image_region->position, 0, 0);
+  init_extent(&image_region->extent, image->width, image->height);
+  list_append(regions, image_region);
+  for (int i = 0; i < threads; i++)
+  {
+    band_t *band = &bands[i];
+    if (band->threaded)
+    {
+      pthread_join(band->thread, NULL);
+    }
+    else
+    {
+      band_scan(band);
+    }
+    if (i == 0)
+    {
+      merge_band(regions, image_region, band, NULL, NULL);
+    }
+    else
+    {
+      band_t *above = &bands[i - 1];
+      int *match = malloc(band->scanner.count * sizeof(int));
+      if (match == NULL)
+      {
+        perror("scanline_find_regions_parallel");
+        exit(EXIT_FAILURE);
+      }
+      if (band_matches(band, above, open_at, parent_at, match))
+      {
+        merge_band(regions, image_region, band, above, match);
+      }
+      else
+      {
+        band_rescan(band, above);
+        merge_band(regions, image_region, band, above, NULL);
+      }
+      free(match);
+      mark_open(open_at, parent_at, above, 1);
+      band_free(above);
+    }
+    mark_open(open_at, parent_at, band, 0);
+  }
+  band_free(&bands[threads - 1]);
+  free(open_at);
+  free(bands);
+}
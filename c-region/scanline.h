@@ -0,0 +1,37 @@
+#ifndef _SCANLINE_H_
+#define _SCANLINE_H_
+
+#include "image.h"
+#include "tree.h"
+#include "typedefs.h"
+
+// Finds all regions located in "image" and adds them to "regions" in the
+// order of region_compare(), in a single row-by-row sweep that does not
+// modify the image. For images of nested rectangles, which is what "regions"
+// processes, the result is identical to find_regions(). Memory use grows with
+// the number of regions, not with their nesting depth.
+void scanline_find_regions(list_t *regions, image_t *image);
+
+// As scanline_find_regions(), and also builds the containment tree of the
+// regions in "tree" as they are found. Destroy the tree with
+// region_tree_destroy() before the regions are.
+void scanline_find_region_tree(region_tree_t *tree, list_t *regions,
+                               image_t *image);
+
+// As scanline_find_regions(), on the rows of "stream", an image opened with
+// image_stream_open() whose rows have not been read yet. The rows are read
+// and swept a band at a time, so images of any height are scanned in memory
+// that grows with the width and the number of regions only.
+void scanline_find_regions_stream(list_t *regions, image_stream_t *stream);
+
+// As scanline_find_regions(), but splits the image into "threads" horizontal
+// bands that are scanned for rectangles on threads of their own, each from a
+// root spanning the band. The bands are then merged in order at their
+// borders: rectangles still open at the bottom of a band continue the ones
+// found again at the top of the next, and a band whose border does not match
+// is scanned again from the open rectangles above it. The result is the same
+// whatever the number of threads.
+void scanline_find_regions_parallel(list_t *regions, image_t *image,
+                                    int threads);
+
+#endif
@@ -0,0 +1,479 @@
+#include "tree.h"
+#include "list.h"
+#include "typedefs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Orders boxes by the x coordinate of their centres.
+static int compare_centre_x(const void *a, const void *b)
+{
+  const region_box_t *first = a;
+  const region_box_t *second = b;
+  int ca = first->x0 + first->x1;
+  int cb = second->x0 + second->x1;
+  return (ca > cb) - (ca < cb);
+}
+
+// Orders boxes by the y coordinate of their centres.
+static int compare_centre_y(const void *a, const void *b)
+{
+  const region_box_t *first = a;
+  const region_box_t *second = b;
+  int ca = first->y0 + first->y1;
+  int cb = second->y0 + second->y1;
+  return (ca > cb) - (ca < cb);
+}
+
+// Groups the "count" boxes of "boxes" into parents of REGION_TREE_FANOUT
+// with Sort-Tile-Recursive packing: the boxes are sorted into vertical slices
+// by x, each slice is sorted by y, and runs of neighbours share a parent.
+// Reorders "boxes", writes the parents to "parents" and returns their number.
+static int str_pack(region_box_t *boxes, int count, region_box_t *parents)
+{
+  int parent_count = (count + REGION_TREE_FANOUT - 1) / REGION_TREE_FANOUT;
+  int slices = 1;
+  while (slices * slices < parent_count)
+  {
+    slices++;
+  }
+  int slice = slices * REGION_TREE_FANOUT;
+
+  qsort(boxes, count, sizeof(region_box_t), compare_centre_x);
+  for (int i = 0; i < count; i += slice)
+  {
+    qsort(boxes + i, count - i < slice ? count - i : slice,
+          sizeof(region_box_t), compare_centre_y);
+  }
+
+  for (int p = 0; p < parent_count; p++)
+  {
+    int first = p * REGION_TREE_FANOUT;
+    int last = count - first < REGION_TREE_FANOUT ? count
+                                                  : first + REGION_TREE_FANOUT;
+    region_box_t *parent = &parents[p];
+    *parent = boxes[first];
+    parent->first = first;
+    parent->count = last - first;
+    for (int i = first + 1; i < last; i++)
+    {
+      parent->x0 = boxes[i].x0 < parent->x0 ? boxes[i].x0 : parent->x0;
+      parent->y0 = boxes[i].y0 < parent->y0 ? boxes[i].y0 : parent->y0;
+      parent->x1 = boxes[i].x1 > parent->x1 ? boxes[i].x1 : parent->x1;
+      parent->y1 = boxes[i].y1 > parent->y1 ? boxes[i].y1 : parent->y1;
+    }
+  }
+  return parent_count;
+}
+
+// Builds the spatial index over the nodes of "tree": a box per region, packed
+// into levels of parents up to a single root box. Returns 0 if memory ran
+// out.
+static int build_index(region_tree_t *tree)
+{
+  int levels = 1;
+  for (int count = tree->count; count > 1;
+       count = (count + REGION_TREE_FANOUT - 1) / REGION_TREE_FANOUT)
+  {
+    levels++;
+  }
+  tree->levels = calloc(levels, sizeof(region_box_t *));
+  tree->level_counts = calloc(levels, sizeof(int));
+  if (tree->levels == NULL || tree->level_counts == NULL)
+  {
+    return 0;
+  }
+  tree->level_count = levels;
+  int count = tree->count;
+  for (int level = 0; level < levels; level++)
+  {
+    tree->levels[level] = malloc((count > 0 ? count : 1)
+                                 * sizeof(region_box_t));
+    if (tree->levels[level] == NULL)
+    {
+      return 0;
+    }
+    tree->level_counts[level] = count;
+    count = (count + REGION_TREE_FANOUT - 1) / REGION_TREE_FANOUT;
+  }
+
+  for (int i = 0; i < tree->count; i++)
+  {
+    const region_t *region = tree->nodes[i].region;
+    region_box_t *box = &tree->levels[0][i];
+    box->x0 = region->position.x;
+    box->y0 = region->position.y;
+    box->x1 = region->position.x + region->extent.width;
+    box->y1 = region->position.y + region->extent.height;
+    box->first = i;
+    box->count = 1;
+  }
+  for (int level = 1; level < levels; level++)
+  {
+    str_pack(tree->levels[level - 1], tree->level_counts[level - 1],
+             tree->levels[level]);
+  }
+  return 1;
+}
+
+// Applies "f" to the nodes below box "index" of level "level" whose regions
+// intersect [x0, x1) x [y0, y1).
+static void query_box(const region_tree_t *tree, int level, int index,
+                      int x0, int y0, int x1, int y1,
+                      region_node_function_t f, void *arg)
+{
+  const region_box_t *box = &tree->levels[level][index];
+  if (box->x0 >= x1 || x0 >= box->x1 || box->y0 >= y1 || y0 >= box->y1)
+  {
+    return;
+  }
+  if (level == 0)
+  {
+    if (tree->nodes[box->first].region != NULL)
+    {
+      f(&tree->nodes[box->first], arg);
+    }
+    return;
+  }
+  for (int i = box->first; i < box->first + box->count; i++)
+  {
+    query_box(tree, level - 1, i, x0, y0, x1, y1, f, arg);
+  }
+}
+
+void region_tree_query(const region_tree_t *tree, int x, int y, int width,
+                       int height, region_node_function_t f, void *arg)
+{
+  if (tree->count > 0)
+  {
+    query_box(tree, tree->level_count - 1, 0, x, y, x + width, y + height, f,
+              arg);
+  }
+  for (int i = 0; i < tree->added_count; i++)
+  {
+    const region_t *region = tree->added[i]->region;
+    if (region != NULL && region->position.x < x + width
+        && x < region->position.x + region->extent.width
+        && region->position.y < y + height
+        && y < region->position.y + region->extent.height)
+    {
+      f(tree->added[i], arg);
+    }
+  }
+}
+
+// Keeps the deepest node it is applied to in "arg", a region_node_t **.
+static void keep_deepest(region_node_t *node, void *arg)
+{
+  region_node_t **deepest = arg;
+  if (*deepest == NULL || node->region->depth > (*deepest)->region->depth)
+  {
+    *deepest = node;
+  }
+}
+
+region_node_t *region_tree_at(const region_tree_t *tree, int x, int y)
+{
+  region_node_t *deepest = NULL;
+  region_tree_query(tree, x, y, 1, 1, keep_deepest, &deepest);
+  return deepest;
+}
+
+// The search for the parent of a region: the node of depth "depth" that
+// contains the region's corner.
+typedef struct parent_search
+{
+  int depth;
+  region_node_t *parent;
+} parent_search_t;
+
+static void find_parent(region_node_t *node, void *arg)
+{
+  parent_search_t *search = arg;
+  if (node->region->depth == search->depth)
+  {
+    search->parent = node;
+  }
+}
+
+int region_tree_init(region_tree_t *tree, region_t **regions,
+                     const int *parents, int count)
+{
+  tree->count = 0;
+  tree->nodes = malloc(count * sizeof(region_node_t));
+  tree->links = malloc(count * sizeof(region_node_t *));
+  tree->levels = NULL;
+  tree->level_counts = NULL;
+  tree->level_count = 0;
+  tree->added = NULL;
+  tree->added_count = 0;
+  tree->added_capacity = 0;
+  tree->removed_count = 0;
+  if (tree->nodes == NULL || tree->links == NULL)
+  {
+    region_tree_destroy(tree);
+    return 0;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    region_node_t *node = &tree->nodes[i];
+    node->region = regions[i];
+    node->elem = NULL;
+    node->parent = NULL;
+    node->children = NULL;
+    node->child_count = 0;
+    node->child_capacity = 0;
+  }
+  tree->count = count;
+  if (!build_index(tree))
+  {
+    region_tree_destroy(tree);
+    return 0;
+  }
+
+  // Link each node to its parent, then lay out the children of each node
+  // contiguously in "links", in node order.
+  for (int i = 0; i < count; i++)
+  {
+    region_node_t *node = &tree->nodes[i];
+    if (parents != NULL)
+    {
+      node->parent = parents[i] >= 0 ? &tree->nodes[parents[i]] : NULL;
+    }
+    else if (node->region->depth > 0)
+    {
+      parent_search_t search = {node->region->depth - 1, NULL};
+      region_tree_query(tree, node->region->position.x,
+                        node->region->position.y, 1, 1, find_parent, &search);
+      node->parent = search.parent;
+    }
+    if (node->parent != NULL)
+    {
+      node->parent->child_count++;
+    }
+  }
+  int next = 0;
+  for (int i = 0; i < count; i++)
+  {
+    tree->nodes[i].children = tree->links + next;
+    next += tree->nodes[i].child_count;
+    tree->nodes[i].child_count = 0;
+  }
+  for (int i = 0; i < count; i++)
+  {
+    region_node_t *parent = tree->nodes[i].parent;
+    if (parent != NULL)
+    {
+      parent->children[parent->child_count++] = &tree->nodes[i];
+    }
+  }
+  return 1;
+}
+
+int region_tree_init_from_list(region_tree_t *tree, list_t *regions)
+{
+  int count = 0;
+  for (list_iter i = list_begin(regions); i != list_end(regions);
+       i = list_iter_next(i))
+  {
+    count++;
+  }
+  region_t **array = malloc(count * sizeof(region_t *));
+  if (array == NULL)
+  {
+    return 0;
+  }
+  count = 0;
+  for (list_iter i = list_begin(regions); i != list_end(regions);
+       i = list_iter_next(i))
+  {
+    array[count++] = list_iter_value(i);
+  }
+  int ok = region_tree_init(tree, array, NULL, count);
+  free(array);
+  if (ok)
+  {
+    list_iter i = list_begin(regions);
+    for (int j = 0; j < count; j++, i = list_iter_next(i))
+    {
+      tree->nodes[j].elem = i;
+    }
+  }
+  return ok;
+}
+
+// Returns 1 if "node" is at or after point (x, y), and before "best" if
+// there is one, in the order of region_compare().
+static int is_next(const region_node_t *node, int x, int y,
+                   const region_node_t *best)
+{
+  point_t point = {x, y};
+  return node->region != NULL
+         && !point_compare_less(&node->region->position, &point)
+         && (best == NULL || region_compare(node->region, best->region));
+}
+
+// Keeps in "best" the first node below box "index" of level "level" at or
+// after point (x, y). The corners of the regions in a box lie in it, so a box
+// is skipped if all of them are before the point, or none of them can come
+// before "best".
+static void next_in_box(const region_tree_t *tree, int level, int index,
+                        int x, int y, region_node_t **best)
+{
+  const region_box_t *box = &tree->levels[level][index];
+  if (box->y1 - 1 < y || (box->y1 - 1 == y && box->x1 - 1 < x))
+  {
+    return;
+  }
+  if (*best != NULL)
+  {
+    const point_t *corner = &(*best)->region->position;
+    if (box->y0 > corner->y || (box->y0 == corner->y && box->x0 >= corner->x))
+    {
+      return;
+    }
+  }
+  if (level == 0)
+  {
+    if (is_next(&tree->nodes[box->first], x, y, *best))
+    {
+      *best = &tree->nodes[box->first];
+    }
+    return;
+  }
+  for (int i = box->first; i < box->first + box->count; i++)
+  {
+    next_in_box(tree, level - 1, i, x, y, best);
+  }
+}
+
+region_node_t *region_tree_next(const region_tree_t *tree, int x, int y)
+{
+  region_node_t *best = NULL;
+  if (tree->count > 0)
+  {
+    next_in_box(tree, tree->level_count - 1, 0, x, y, &best);
+  }
+  for (int i = 0; i < tree->added_count; i++)
+  {
+    if (is_next(tree->added[i], x, y, best))
+    {
+      best = tree->added[i];
+    }
+  }
+  return best;
+}
+
+// Makes room for one more child of "node", moving its children out of the
+// tree's "links" into an array of its own. Returns 0 if memory ran out.
+static int reserve_child(region_node_t *node)
+{
+  if (node->child_capacity > node->child_count)
+  {
+    return 1;
+  }
+  int capacity = 2 * node->child_count + 4;
+  region_node_t **children = malloc(capacity * sizeof(region_node_t *));
+  if (children == NULL)
+  {
+    return 0;
+  }
+  if (node->child_count > 0)
+  {
+    memcpy(children, node->children,
+           node->child_count * sizeof(region_node_t *));
+  }
+  if (node->child_capacity > 0)
+  {
+    free(node->children);
+  }
+  node->children = children;
+  node->child_capacity = capacity;
+  return 1;
+}
+
+region_node_t *region_tree_add(region_tree_t *tree, region_t *region,
+                               region_node_t *parent, list_iter elem)
+{
+  if (tree->added_count == tree->added_capacity)
+  {
+    int capacity = tree->added_capacity > 0 ? 2 * tree->added_capacity : 16;
+    region_node_t **added = realloc(tree->added,
+                                    capacity * sizeof(region_node_t *));
+    if (added == NULL)
+    {
+      return NULL;
+    }
+    tree->added = added;
+    tree->added_capacity = capacity;
+  }
+  region_node_t *node = malloc(sizeof(region_node_t));
+  if (node == NULL || !reserve_child(parent))
+  {
+    free(node);
+    return NULL;
+  }
+  node->region = region;
+  node->elem = elem;
+  node->parent = parent;
+  node->children = NULL;
+  node->child_count = 0;
+  node->child_capacity = 0;
+  tree->added[tree->added_count++] = node;
+  parent->children[parent->child_count++] = node;
+  return node;
+}
+
+void region_tree_remove(region_tree_t *tree, region_node_t *node,
+                        region_node_function_t f, void *arg)
+{
+  for (int i = 0; i < node->child_count; i++)
+  {
+    if (node->children[i]->region != NULL)
+    {
+      region_tree_remove(tree, node->children[i], f, arg);
+    }
+  }
+  f(node, arg);
+  node->region = NULL;
+  tree->removed_count++;
+}
+
+void region_tree_destroy(region_tree_t *tree)
+{
+  for (int i = 0; i < tree->count; i++)
+  {
+    if (tree->nodes[i].child_capacity > 0)
+    {
+      free(tree->nodes[i].children);
+    }
+  }
+  for (int i = 0; i < tree->added_count; i++)
+  {
+    if (tree->added[i]->child_capacity > 0)
+    {
+      free(tree->added[i]->children);
+    }
+    free(tree->added[i]);
+  }
+  free(tree->added);
+  for (int level = 0; level < tree->level_count; level++)
+  {
+    free(tree->levels[level]);
+  }
+  free(tree->levels);
+  free(tree->level_counts);
+  free(tree->nodes);
+  free(tree->links);
+  tree->nodes = NULL;
+  tree->links = NULL;
+  tree->levels = NULL;
+  tree->level_counts = NULL;
+  tree->added = NULL;
+  tree->count = 0;
+  tree->level_count = 0;
+  tree->added_count = 0;
+  tree->added_capacity = 0;
+  tree->removed_count = 0;
+}
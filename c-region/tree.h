@@ -0,0 +1,104 @@
+#ifndef _TREE_H_
+#define _TREE_H_
+
+#include <stdint.h>
+#include "typedefs.h"
+
+// Number of children of each box of the spatial index.
+enum {REGION_TREE_FANOUT = 16};
+
+// A region and its place in the containment hierarchy. "children" holds
+// "child_count" nodes in the order of region_compare(), followed by those
+// added since the tree was built; the image region has no parent. "elem" is
+// the region's element in the list the tree was built from, if any. A
+// removed node keeps its place among its parent's children, with "region"
+// set to NULL. "child_capacity" is 0 while "children" lies in the tree's
+// "links", and the size of the node's own array once children have been
+// added to it.
+typedef struct region_node
+{
+  region_t *region;
+  list_iter elem;
+  struct region_node *parent;
+  struct region_node **children;
+  int child_count;
+  int child_capacity;
+} region_node_t;
+
+// The bounding box, [x0, x1) x [y0, y1), of boxes "first" to
+// "first + count - 1" of the level below. At the lowest level a box is a
+// single region and "first" is the index of its node.
+typedef struct region_box
+{
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+  int first;
+  int count;
+} region_box_t;
+
+// The regions of an image as a containment tree, plus a packed R-tree over
+// their rectangles for point and rectangle queries. "nodes" are in the order
+// of region_compare(), so they are also a flat, ordered traversal; nodes[0]
+// is the image region. Nodes added later are not in the R-tree: queries check
+// the "added_count" nodes of "added" one by one, and skip the
+// "removed_count" removed nodes, until the tree is built again.
+typedef struct region_tree
+{
+  region_node_t *nodes;
+  int count;
+  region_node_t **links;
+  region_box_t **levels;
+  int *level_counts;
+  int level_count;
+  region_node_t **added;
+  int added_count;
+  int added_capacity;
+  int removed_count;
+} region_tree_t;
+
+// region_node_function_t is the type of a function applied to the nodes found
+// by a query, with the argument given to the query.
+typedef void (*region_node_function_t)(region_node_t *node, void *arg);
+
+// Builds "tree" over the "count" regions of "regions", which are in the order
+// of region_compare(), starting with the image region. parents[i] is the
+// index of the region containing regions[i], or -1 for the image region; if
+// "parents" is NULL, parents are found with the spatial index. The regions
+// are not copied, so they must outlive the tree. Returns 0 if memory ran out.
+int region_tree_init(region_tree_t *tree, region_t **regions,
+                     const int *parents, int count);
+
+// As region_tree_init(), for the regions of "regions", as produced by
+// find_regions(). Each node records the element of its region.
+int region_tree_init_from_list(region_tree_t *tree, list_t *regions);
+
+// Applies "f" to every node whose region intersects the width x height
+// rectangle at (x, y), in O(log n) time plus the number of nodes found.
+void region_tree_query(const region_tree_t *tree, int x, int y, int width,
+                       int height, region_node_function_t f, void *arg);
+
+// Returns the deepest node whose region contains point (x, y), or NULL if the
+// point lies outside the image.
+region_node_t *region_tree_at(const region_tree_t *tree, int x, int y);
+
+// Returns the node whose region comes first in the order of region_compare()
+// among those at or after point (x, y), or NULL if there is none.
+region_node_t *region_tree_next(const region_tree_t *tree, int x, int y);
+
+// Adds a node for "region", whose list element is "elem", as the last child
+// of "parent", and returns it, or NULL if memory ran out. The region must not
+// be inside any child of "parent".
+region_node_t *region_tree_add(region_tree_t *tree, region_t *region,
+                               region_node_t *parent, list_iter elem);
+
+// Removes "node", which is not the image region, and its descendants from
+// "tree", first applying "f" to each of them. Queries no longer find them.
+void region_tree_remove(region_tree_t *tree, region_node_t *node,
+                        region_node_function_t f, void *arg);
+
+// Deallocates the nodes and index of "tree", but not its regions.
+void region_tree_destroy(region_tree_t *tree);
+
+#endif
@@ -39,11 +39,13 @@ typedef struct list_elem
 } list_elem_t;
 
 
-// A list of regions
+// A list of regions. If "arena" is not NULL, the list's elements and regions
+// are allocated from it, and freed with it by list_destroy().
 typedef struct list
 {
   list_elem_t *header;
   list_elem_t *footer;
+  struct region_arena *arena;
 } list_t;
 
 // Iterator type that can be used to iterate over the elements of a
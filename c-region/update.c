@@ -0,0 +1,381 @@
+#include "update.h"
+#include "image.h"
+#include "list.h"
+#include "region.h"
+#include "scanline.h"
+#include "tree.h"
+#include "typedefs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A rectangle [x0, x1) x [y0, y1).
+typedef struct rect
+{
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+} rect_t;
+
+// The children of "container" that are found again, and the rectangle
+// "cover" that is scanned for them.
+typedef struct rescan
+{
+  region_node_t *container;
+  rect_t bounds;        // the rectangle of the container
+  uint8_t value;        // the pixel value of the container
+  int whole;            // every child of the container is found again
+  rect_t cover;
+  rect_t margin;        // the changed pixels and the pixels around them
+  region_node_t **removed;  // the children found again
+  int removed_count;
+  int removed_capacity;
+  region_node_t *found;     // the deepest node around "margin" so far
+  image_t *copy;            // the copy of "cover" being scanned
+} rescan_t;
+
+static rect_t region_rect(const region_t *region)
+{
+  rect_t rect = {region->position.x, region->position.y,
+                 region->position.x + region->extent.width,
+                 region->position.y + region->extent.height};
+  return rect;
+}
+
+static int rect_contains(const rect_t *outer, const rect_t *inner)
+{
+  return outer->x0 <= inner->x0 && outer->y0 <= inner->y0
+         && inner->x1 <= outer->x1 && inner->y1 <= outer->y1;
+}
+
+static int rect_intersects(const rect_t *a, const rect_t *b)
+{
+  return a->x0 < b->x1 && b->x0 < a->x1 && a->y0 < b->y1 && b->y0 < a->y1;
+}
+
+// Grows "rect" to cover "other".
+static void rect_cover(rect_t *rect, const rect_t *other)
+{
+  rect->x0 = other->x0 < rect->x0 ? other->x0 : rect->x0;
+  rect->y0 = other->y0 < rect->y0 ? other->y0 : rect->y0;
+  rect->x1 = other->x1 > rect->x1 ? other->x1 : rect->x1;
+  rect->y1 = other->y1 > rect->y1 ? other->y1 : rect->y1;
+}
+
+// Returns the first channel of pixel (x, y) of "image", through its row if
+// the image is row-major.
+static uint8_t pixel_at(image_t *image, int x, int y)
+{
+  if (image->layout == IMAGE_ROW_MAJOR)
+  {
+    return image_row(image, y)[x * image->nChannels];
+  }
+  return get_pixel(image, x, y);
+}
+
+// Keeps in the rescan_t "arg" the deepest node found whose region contains
+// the margin.
+static void find_container(region_node_t *node, void *arg)
+{
+  rescan_t *rescan = arg;
+  rect_t rect = region_rect(node->region);
+  if (rect_contains(&rect, &rescan->margin)
+      && (rescan->found == NULL
+          || node->region->depth > rescan->found->region->depth))
+  {
+    rescan->found = node;
+  }
+}
+
+// Adds "node" to the children of the container in the rescan_t "arg" that
+// are found again if it is one of them and it meets the margin. The
+// rectangle scanned is grown to cover it.
+static void find_removed(region_node_t *node, void *arg)
+{
+  rescan_t *rescan = arg;
+  if (node->parent != rescan->container)
+  {
+    return;
+  }
+  if (rescan->removed_count == rescan->removed_capacity)
+  {
+    rescan->removed_capacity = rescan->removed_capacity > 0
+                               ? 2 * rescan->removed_capacity : 16;
+    rescan->removed = realloc(rescan->removed, rescan->removed_capacity
+                                               * sizeof(region_node_t *));
+    if (rescan->removed == NULL)
+    {
+      perror("update_regions");
+      exit(EXIT_FAILURE);
+    }
+  }
+  rescan->removed[rescan->removed_count++] = node;
+  rect_t rect = region_rect(node->region);
+  rect_cover(&rescan->cover, &rect);
+}
+
+// Chooses the children of the container to be found again: all of them if
+// the whole container is scanned, and otherwise those that meet the margin.
+// The rectangle scanned is grown to cover them.
+static void collect_children(rescan_t *rescan, region_tree_t *tree)
+{
+  rescan->removed_count = 0;
+  if (rescan->whole)
+  {
+    rescan->cover = rescan->bounds;
+    for (int i = 0; i < rescan->container->child_count; i++)
+    {
+      if (rescan->container->children[i]->region != NULL)
+      {
+        find_removed(rescan->container->children[i], rescan);
+      }
+    }
+    return;
+  }
+  const rect_t *margin = &rescan->margin;
+  rescan->cover = *margin;
+  region_tree_query(tree, margin->x0, margin->y0, margin->x1 - margin->x0,
+                    margin->y1 - margin->y0, find_removed, rescan);
+}
+
+// Fills the part inside the rectangle scanned of "node", if it is a child of
+// the container that is kept, with the container's value in the copy of the
+// rescan_t "arg", as find_regions() does with the children it has found.
+// Kept children are those that do not meet the margin.
+static void fill_kept(region_node_t *node, void *arg)
+{
+  rescan_t *rescan = arg;
+  rect_t rect = region_rect(node->region);
+  if (node->parent != rescan->container
+      || rect_intersects(&rect, &rescan->margin))
+  {
+    return;
+  }
+  const rect_t *cover = &rescan->cover;
+  rect_t kept = rect;
+  kept.x0 = kept.x0 > cover->x0 ? kept.x0 : cover->x0;
+  kept.y0 = kept.y0 > cover->y0 ? kept.y0 : cover->y0;
+  kept.x1 = kept.x1 < cover->x1 ? kept.x1 : cover->x1;
+  kept.y1 = kept.y1 < cover->y1 ? kept.y1 : cover->y1;
+  image_fill_rect(rescan->copy, kept.x0 - cover->x0 + 1,
+                  kept.y0 - cover->y0 + 1, kept.x1 - kept.x0,
+                  kept.y1 - kept.y0, rescan->value);
+}
+
+// Finds the regions inside the rectangle scanned, and their tree, in
+// "found". The rectangle is copied row by row into an image of its own,
+// framed by a pixel of the container's value so that it reads as the
+// container, and with the children that are kept filled in. The first region
+// is the copy itself, which stands for the container; the others are moved
+// to where they are in "image".
+static void scan_cover(rescan_t *rescan, region_tree_t *found_tree,
+                       list_t *found, region_tree_t *tree, image_t *image)
+{
+  const rect_t *cover = &rescan->cover;
+  int width = cover->x1 - cover->x0;
+  int height = cover->y1 - cover->y0;
+  image_error_t res = init_image(&rescan->copy, width + 2, height + 2, GRAY,
+                                 255);
+  if (res != IMG_OK)
+  {
+    image_print_error(res);
+    exit(EXIT_FAILURE);
+  }
+  image_fill_rect(rescan->copy, 0, 0, width + 2, height + 2, rescan->value);
+  for (int y = 0; y < height; y++)
+  {
+    uint8_t *row = image_row(rescan->copy, y + 1) + 1;
+    if (image->layout == IMAGE_ROW_MAJOR && image->nChannels == 1)
+    {
+      memcpy(row, image_row(image, cover->y0 + y) + cover->x0, width);
+      continue;
+    }
+    for (int x = 0; x < width; x++)
+    {
+      row[x] = pixel_at(image, cover->x0 + x, cover->y0 + y);
+    }
+  }
+
+  if (!rescan->whole)
+  {
+    region_tree_query(tree, cover->x0, cover->y0, width, height, fill_kept,
+                      rescan);
+  }
+
+  scanline_find_region_tree(found_tree, found, rescan->copy);
+  image_free(rescan->copy);
+  for (int i = 1; i < found_tree->count; i++)
+  {
+    region_t *region = found_tree->nodes[i].region;
+    region->position.x += cover->x0 - 1;
+    region->position.y += cover->y0 - 1;
+    region->depth += rescan->container->region->depth;
+  }
+}
+
+// Returns 1 if a region of "found" that reaches an edge of the rectangle
+// scanned could continue past it: if the pixel beyond its corner row or
+// column, inside the container, has the region's value. Only the whole
+// container is then certain to hold the regions.
+static int spills(const rescan_t *rescan, const region_tree_t *found,
+                  image_t *image)
+{
+  const rect_t *cover = &rescan->cover;
+  const rect_t *bounds = &rescan->bounds;
+  for (int i = 1; i < found->count; i++)
+  {
+    rect_t rect = region_rect(found->nodes[i].region);
+    uint8_t value = pixel_at(image, rect.x0, rect.y0);
+    if ((rect.x0 == cover->x0 && rect.x0 > bounds->x0
+         && pixel_at(image, rect.x0 - 1, rect.y0) == value)
+        || (rect.y0 == cover->y0 && rect.y0 > bounds->y0
+            && pixel_at(image, rect.x0, rect.y0 - 1) == value)
+        || (rect.x1 == cover->x1 && rect.x1 < bounds->x1
+            && pixel_at(image, rect.x1, rect.y0) == value)
+        || (rect.y1 == cover->y1 && rect.y1 < bounds->y1
+            && pixel_at(image, rect.x0, rect.y1) == value))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Erases the element of the region of "node" from "arg", a list_t.
+static void erase_region(region_node_t *node, void *arg)
+{
+  list_erase(arg, node->elem);
+}
+
+// Removes the children found again, with their descendants, from "regions"
+// and "tree", and adds copies of the regions of "found" to both. Each copy
+// goes before the first region after it, found through the tree.
+static void merge_found(const rescan_t *rescan, list_t *regions,
+                        region_tree_t *tree, const region_tree_t *found)
+{
+  for (int i = 0; i < rescan->removed_count; i++)
+  {
+    region_tree_remove(tree, rescan->removed[i], erase_region, regions);
+  }
+
+  region_node_t **added = malloc(found->count * sizeof(region_node_t *));
+  if (added == NULL)
+  {
+    perror("update_regions");
+    exit(EXIT_FAILURE);
+  }
+  added[0] = rescan->container;
+  for (int i = 1; i < found->count; i++)
+  {
+    const region_node_t *source = &found->nodes[i];
+    region_t *copy = list_allocate_region(regions);
+    *copy = *source->region;
+    region_node_t *next = region_tree_next(tree, copy->position.x,
+                                           copy->position.y);
+    list_iter at = next != NULL ? next->elem : list_end(regions);
+    list_insert_at(regions, at, copy);
+    added[i] = region_tree_add(tree, copy, added[source->parent - found->nodes],
+                               list_iter_prev(at));
+    if (added[i] == NULL)
+    {
+      perror("update_regions");
+      exit(EXIT_FAILURE);
+    }
+  }
+  free(added);
+}
+
+size_t update_regions(list_t *regions, region_tree_t *tree, image_t *image,
+                      const point_t *position, const extent_t *extent)
+{
+  if (extent->width <= 0 || extent->height <= 0)
+  {
+    return 0;
+  }
+  if (tree->count == 0)
+  {
+    scanline_find_regions(regions, image);
+    if (!region_tree_init_from_list(tree, regions))
+    {
+      perror("update_regions");
+      exit(EXIT_FAILURE);
+    }
+    return (size_t) image->width * image->height;
+  }
+
+  rect_t dirty = {position->x, position->y, position->x + extent->width,
+                  position->y + extent->height};
+  rect_t grown = {dirty.x0 - 1, dirty.y0 - 1, dirty.x1 + 1, dirty.y1 + 1};
+  rescan_t rescan;
+  rescan.margin.x0 = grown.x0 > 0 ? grown.x0 : 0;
+  rescan.margin.y0 = grown.y0 > 0 ? grown.y0 : 0;
+  rescan.margin.x1 = grown.x1 < image->width ? grown.x1 : image->width;
+  rescan.margin.y1 = grown.y1 < image->height ? grown.y1 : image->height;
+
+  // Find the container: the deepest region around the changed pixels and
+  // their margin, so that its corner row and column, and the pixels just
+  // past them, are unchanged. The image region contains every change.
+  const rect_t *margin = &rescan.margin;
+  rescan.found = NULL;
+  if (grown.x0 >= 0 && grown.y0 >= 0 && grown.x1 <= image->width
+      && grown.y1 <= image->height)
+  {
+    region_tree_query(tree, margin->x0, margin->y0, margin->x1 - margin->x0,
+                      margin->y1 - margin->y0, find_container, &rescan);
+  }
+  rescan.container = rescan.found != NULL ? rescan.found : &tree->nodes[0];
+  const region_t *container = rescan.container->region;
+  rescan.bounds = region_rect(container);
+  rescan.value = pixel_at(image, container->position.x,
+                          container->position.y);
+  rescan.removed = NULL;
+  rescan.removed_capacity = 0;
+  // Only the image region can have its corner changed, and then each of its
+  // children may have merged with it.
+  rescan.whole = dirty.x0 <= container->position.x
+                 && container->position.x < dirty.x1
+                 && dirty.y0 <= container->position.y
+                 && container->position.y < dirty.y1;
+
+  region_tree_t found_tree;
+  list_t found;
+  size_t scanned = 0;
+  for (;;)
+  {
+    collect_children(&rescan, tree);
+    list_init(&found);
+    scan_cover(&rescan, &found_tree, &found, tree, image);
+    scanned += (size_t) (rescan.cover.x1 - rescan.cover.x0)
+               * (rescan.cover.y1 - rescan.cover.y0);
+    if (rescan.whole || !spills(&rescan, &found_tree, image))
+    {
+      break;
+    }
+    region_tree_destroy(&found_tree);
+    list_destroy(&found);
+    rescan.whole = 1;
+  }
+
+  merge_found(&rescan, regions, tree, &found_tree);
+  region_tree_destroy(&found_tree);
+  list_destroy(&found);
+  free(rescan.removed);
+
+  // Added nodes are searched one by one and removed ones still fill the
+  // index, so the tree is built again once they outnumber 16 times the square
+  // root of the number of regions: both costs stay near that square root per
+  // region changed.
+  long changed = tree->added_count + tree->removed_count;
+  if (changed * changed > 256L * tree->count)
+  {
+    region_tree_destroy(tree);
+    if (!region_tree_init_from_list(tree, regions))
+    {
+      perror("update_regions");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return scanned;
+}
@@ -0,0 +1,26 @@
+#ifndef _UPDATE_H_
+#define _UPDATE_H_
+
+#include "image.h"
+#include "tree.h"
+#include "typedefs.h"
+#include <stddef.h>
+
+// Updates "regions", the regions of an image in the order of
+// region_compare(), to those of "image", which differs from that image only
+// in the rectangle of size "extent" at "position". The deepest region that
+// contains the rectangle with a margin of one pixel keeps its extent, as does
+// each of its children clear of the margin; the others are removed with
+// their descendants and found again by scanning the smallest rectangle that
+// covers them and the margin. For images of nested rectangles the result is
+// the same as that of find_regions() on "image". "tree" is the tree of
+// "regions", built with region_tree_init_from_list(), and is kept up to
+// date. The regions affected are found through it rather than by walking the
+// list: the pixels read grow with the changed area, and the other work with
+// the regions near it, plus a rebuild of the tree once the regions changed
+// since it was built outnumber 16 times the square root of their number.
+// Returns the number of pixels scanned.
+size_t update_regions(list_t *regions, region_tree_t *tree, image_t *image,
+                      const point_t *position, const extent_t *extent);
+
+#endif